@@ -0,0 +1,148 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, TEC, Costa Rica
+ *
+ * This file is part of the CE3102 Numerical Analysis lecture at TEC
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <complex>
+
+/**
+ * Benchmarks for the matrix product
+ */
+#include "benchmarkFramework.hpp"
+#include "Matrix.hpp"
+#include "Allocator.hpp"
+
+BOOST_AUTO_TEST_SUITE(Matrix)
+
+/// Benchmark for the matrix product
+template <typename T>
+class benchProduct
+{
+  protected:
+    /// Maximum allowed size for the square matrices
+    const size_t _maxSize;
+
+    /// A large matrix holding
+    anpi::Matrix<T> _data;
+
+    /// State of the benchmarked evaluation
+    anpi::Matrix<T> _a;
+    anpi::Matrix<T> _b;
+    anpi::Matrix<T> _c;
+
+  public:
+    /// Construct
+    benchProduct(const size_t maxSize)
+        : _maxSize(maxSize), _data(maxSize, maxSize, anpi::DoNotInitialize)
+    {
+
+        size_t idx = 0;
+        for (size_t r = 0; r < _maxSize; ++r)
+        {
+            for (size_t c = 0; c < _maxSize; ++c)
+            {
+                _data(r, c) = T(idx++ % 17) / T(17);
+            }
+        }
+    }
+
+    /// Prepare the evaluation of given size
+    void prepare(const size_t size)
+    {
+        assert(size <= this->_maxSize);
+        this->_a = std::move(anpi::Matrix<T>(size, size, _data.data()));
+        this->_b = this->_a;
+    }
+};
+
+/// Provide the evaluation method for the fallback product
+template <typename T>
+class benchProductFallback : public benchProduct<T>
+{
+  public:
+    /// Constructor
+    benchProductFallback(const size_t n) : benchProduct<T>(n) {}
+
+    // Evaluate the product
+    inline void eval()
+    {
+        anpi::fallback::multiply(this->_a, this->_b, this->_c);
+    }
+};
+
+/// Provide the evaluation method for the blocked SIMD product
+template <typename T>
+class benchProductSIMD : public benchProduct<T>
+{
+  public:
+    /// Constructor
+    benchProductSIMD(const size_t n) : benchProduct<T>(n) {}
+
+    // Evaluate the product
+    inline void eval()
+    {
+        anpi::simd::multiply(this->_a, this->_b, this->_c);
+    }
+};
+
+/**
+ * Compare the fallback and the blocked SIMD matrix products
+ */
+BOOST_AUTO_TEST_CASE(Product)
+{
+
+    std::vector<size_t> sizes = {24, 32, 48, 64,
+                                 96, 128, 192, 256,
+                                 384, 512, 768, 1024};
+
+    const size_t n = sizes.back();
+    const size_t repetitions = 5;
+    std::vector<anpi::benchmark::measurement> times;
+
+    {
+        benchProductFallback<float> bp(n);
+
+        ANPI_BENCHMARK(sizes, repetitions, times, bp);
+
+        ::anpi::benchmark::write("product_float_fb.txt", times);
+        ::anpi::benchmark::plotRange(times, "Product (float) fallback", "r");
+    }
+
+    {
+        benchProductSIMD<float> bp(n);
+
+        ANPI_BENCHMARK(sizes, repetitions, times, bp);
+
+        ::anpi::benchmark::write("product_float_simd.txt", times);
+        ::anpi::benchmark::plotRange(times, "Product (float) simd", "g");
+    }
+
+    {
+        benchProductFallback<double> bp(n);
+
+        ANPI_BENCHMARK(sizes, repetitions, times, bp);
+
+        ::anpi::benchmark::write("product_double_fb.txt", times);
+        ::anpi::benchmark::plotRange(times, "Product (double) fallback", "b");
+    }
+
+    {
+        benchProductSIMD<double> bp(n);
+
+        ANPI_BENCHMARK(sizes, repetitions, times, bp);
+
+        ::anpi::benchmark::write("product_double_simd.txt", times);
+        ::anpi::benchmark::plotRange(times, "Product (double) simd", "m");
+    }
+
+    ::anpi::benchmark::show();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,127 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, TEC, Costa Rica
+ *
+ * This file is part of the CE3102 Numerical Analysis lecture at TEC
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+
+/**
+ * Benchmarks for the multigrid solver of the nodal system of a map
+ */
+#include "benchmarkFramework.hpp"
+#include "Multigrid.hpp"
+
+BOOST_AUTO_TEST_SUITE(Multigrid)
+
+/// Benchmark for setting up and solving the floating Laplacian of a map
+template <typename T>
+class benchMultigrid
+{
+  protected:
+    /// Fraction of wall pixels, scattered at random
+    const double _walls;
+
+    /// State of the benchmarked evaluation
+    anpi::GridOperator<T> _laplacian;
+    anpi::Multigrid<T> _mg;
+    typename anpi::Multigrid<T>::Workspace _ws;
+    std::vector<T> _b;
+    std::vector<T> _x;
+
+  public:
+    /// Construct
+    benchMultigrid(const double walls) : _walls(walls) {}
+
+    /// Prepare the Laplacian of a map with size x size pixels
+    void prepare(const size_t size)
+    {
+        std::mt19937 generator(7);
+        std::uniform_real_distribution<double> uniform(0., 1.);
+
+        std::vector<T> r(size * size, T(1));
+        for (auto &resistance : r)
+        {
+            if (uniform(generator) < _walls)
+                resistance = T(1.0e6);
+        }
+
+        _laplacian.allocate(size, size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            for (size_t j = 0; j < size; ++j)
+            {
+                const size_t k = i * size + j;
+                if (j + 1 < size)
+                {
+                    const T g = T(1) / std::max(r[k], r[k + 1]);
+                    _laplacian.diag[k] += g;
+                    _laplacian.diag[k + 1] += g;
+                    _laplacian.east[k] = g;
+                }
+                if (i + 1 < size)
+                {
+                    const T g = T(1) / std::max(r[k], r[k + size]);
+                    _laplacian.diag[k] += g;
+                    _laplacian.diag[k + size] += g;
+                    _laplacian.south[k] = g;
+                }
+            }
+        }
+
+        //current from one corner to the opposite one
+        _b.assign(size * size, T(0));
+        _b.front() = T(1);
+        _b.back() = T(-1);
+    }
+
+    /// Set up the hierarchy and solve
+    inline void eval()
+    {
+        _mg.setup(_laplacian, anpi::MultigridSettings<T>());
+        _x.clear();
+        _mg.solve(_x, _b, _ws);
+    }
+};
+
+/**
+ * Setup and solution of maps up to 1000 x 1000 pixels, without walls
+ * and with 10% of scattered walls
+ */
+BOOST_AUTO_TEST_CASE(NodalSystem)
+{
+
+    std::vector<size_t> sizes = {125, 250, 500, 1000};
+
+    const size_t repetitions = 2;
+    std::vector<anpi::benchmark::measurement> times;
+
+    {
+        benchMultigrid<double> bm(0.0);
+
+        ANPI_BENCHMARK(sizes, repetitions, times, bm);
+
+        ::anpi::benchmark::write("multigrid_clean.txt", times);
+        ::anpi::benchmark::plotRange(times, "Multigrid without walls", "g");
+    }
+
+    {
+        benchMultigrid<double> bm(0.1);
+
+        ANPI_BENCHMARK(sizes, repetitions, times, bm);
+
+        ::anpi::benchmark::write("multigrid_walls.txt", times);
+        ::anpi::benchmark::plotRange(times, "Multigrid with 10% walls", "r");
+    }
+
+    ::anpi::benchmark::show();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
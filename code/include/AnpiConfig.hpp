@@ -10,3 +10,4 @@
 #define ANPI_ENABLE_SIMD
 /* #undef ANPI_ENABLE_OpenMP */
 #define ANPI_DATA_PATH "/home/acacia/git/ANPI_Proyecto2/code/data"
+#define ANPI_LU_BLOCK_SIZE 64
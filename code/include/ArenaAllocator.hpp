@@ -0,0 +1,322 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#ifndef ANPI_ARENA_ALLOCATOR_HPP
+#define ANPI_ARENA_ALLOCATOR_HPP
+
+#include <boost/align/aligned_alloc.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "Allocator.hpp"
+
+namespace anpi {
+
+  /**
+   * Preallocated memory region handed out with a bump pointer.
+   *
+   * Allocating just advances a pointer, and releasing is in general a
+   * no-op: all memory is released at once with reset(), for instance
+   * after each query that produced a set of temporary matrices.  Only
+   * the most recent allocation is given back immediately, so that
+   * temporaries destroyed in reverse order reuse their memory.
+   *
+   * If the region is exhausted the memory is taken from the heap, and
+   * the next reset() enlarges the region so that the same workload fits
+   * into it the next time.
+   *
+   * An arena must not be used by several threads at the same time, and
+   * the memory allocated from it must not be used after reset().
+   */
+  class Arena {
+  public:
+    /// Alignment of the region itself
+    static constexpr size_t RegionAlignment = 64;
+
+    /// Create an arena with a region of the given number of bytes
+    explicit Arena(const size_t bytes=0)
+      : _begin(nullptr), _capacity(0), _used(0), _peak(0), _overflowBytes(0) {
+      reserve(bytes);
+    }
+
+    /// Release the region and all memory taken from the heap
+    ~Arena() {
+      releaseOverflow();
+      boost::alignment::aligned_free(_begin);
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * Reserve bytes with the given alignment, which must be a power
+     * of two.
+     *
+     * @throws std::bad_alloc if no memory is available
+     */
+    void* allocate(const size_t bytes,const size_t alignment) {
+      const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(_begin);
+      const std::uintptr_t first =
+        (base + _used + (alignment-1)) & ~std::uintptr_t(alignment-1);
+      const size_t end = size_t(first - base) + bytes;
+
+      if ((_begin != nullptr) && (end <= _capacity)) {
+        _used = end;
+        _peak = (_used > _peak) ? _used : _peak;
+        return reinterpret_cast<void*>(first);
+      }
+
+      // the region is exhausted: take it from the heap until reset()
+      const size_t align =
+        (alignment < sizeof(void*)) ? sizeof(void*) : alignment;
+      void* ptr = boost::alignment::aligned_alloc(align,bytes);
+      if (ptr == nullptr) {
+        throw std::bad_alloc();
+      }
+      _overflow.push_back(ptr);
+      _overflowBytes += bytes + align;
+      return ptr;
+    }
+
+    /// Give back the memory at ptr, if it was the last allocation
+    void deallocate(void* ptr,const size_t bytes) noexcept {
+      char* p = static_cast<char*>(ptr);
+      if ((p >= _begin) && (p < _begin + _capacity) &&
+          (p + bytes == _begin + _used)) {
+        _used = size_t(p - _begin);
+      }
+    }
+
+    /**
+     * Release all memory allocated so far.
+     *
+     * If the region was exhausted since the last reset, it is replaced
+     * by one large enough for everything allocated in the meantime.
+     */
+    void reset() {
+      if (_overflowBytes != 0) {
+        const size_t bytes = _peak + _overflowBytes;
+        releaseOverflow();
+        boost::alignment::aligned_free(_begin);
+        _begin = nullptr;
+        _capacity = 0;
+        reserve(bytes);
+      }
+      _used = 0;
+      _peak = 0;
+    }
+
+    /// Size in bytes of the region
+    inline size_t capacity() const { return _capacity; }
+
+    /// Bytes of the region currently in use
+    inline size_t used() const { return _used; }
+
+    /// Check if some memory had to be taken from the heap since reset()
+    inline bool overflowed() const { return _overflowBytes != 0; }
+
+    /**
+     * Arena used by default constructed arena allocators of the
+     * current thread, or nullptr if there is none.
+     *
+     * @see Arena::Scope
+     */
+    static Arena*& current() {
+      static thread_local Arena* arena = nullptr;
+      return arena;
+    }
+
+    /**
+     * Makes an arena the current one of this thread while the scope
+     * lives, and resets it at the end of the scope.
+     *
+     * All matrices allocated from the arena must have been destroyed
+     * when the scope ends, which is the case if they are declared after
+     * the scope object:
+     *
+     * \code
+     * anpi::Arena arena(1 << 20);
+     * ...
+     * {
+     *   anpi::Arena::Scope scope(arena);
+     *   anpi::Matrix<float,anpi::arena_row_allocator<float> > A(n,n);
+     *   ...
+     * }
+     * \endcode
+     */
+    class Scope {
+    public:
+      explicit Scope(Arena& arena) : _arena(arena), _previous(current()) {
+        current() = &arena;
+      }
+
+      ~Scope() {
+        current() = _previous;
+        _arena.reset();
+      }
+
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+
+    private:
+      Arena& _arena;
+      Arena* _previous;
+    };
+
+  private:
+    /// Allocate a new region of the given size
+    void reserve(const size_t bytes) {
+      if (bytes != 0) {
+        const size_t rounded =
+          (bytes + (RegionAlignment-1)) & ~(RegionAlignment-1);
+        _begin = static_cast<char*>(
+          boost::alignment::aligned_alloc(RegionAlignment,rounded));
+        if (_begin == nullptr) {
+          throw std::bad_alloc();
+        }
+        _capacity = rounded;
+      }
+    }
+
+    /// Free all blocks taken from the heap
+    void releaseOverflow() noexcept {
+      for (void* ptr : _overflow) {
+        boost::alignment::aligned_free(ptr);
+      }
+      _overflow.clear();
+      _overflowBytes = 0;
+    }
+
+    char* _begin;
+    size_t _capacity;
+    size_t _used;
+    size_t _peak;
+    size_t _overflowBytes;
+    std::vector<void*> _overflow;
+  };
+
+  /**
+   * Allocator taking the memory from an anpi::Arena, aligning each
+   * allocation to Align bytes.
+   *
+   * Default constructed allocators use the current arena of the thread
+   * (see Arena::Scope), or the heap if there is none.  Two allocators
+   * are equal if they use the same arena.
+   */
+  template<class T, std::size_t Align=DefaultAlignment>
+  class arena_allocator {
+  public:
+    static_assert((Align & (Align-1)) == 0,"Alignment must be a power of two");
+    static_assert(Align >= alignof(T),"Alignment too small for the type");
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    /// Change the stored type
+    template<class U>
+    struct rebind {
+      typedef arena_allocator<U, Align> other;
+    };
+
+    /// Use the current arena of the thread
+    arena_allocator() noexcept : _arena(Arena::current()) {}
+
+    /// Use the given arena
+    explicit arena_allocator(Arena& arena) noexcept : _arena(&arena) {}
+
+    template<class U>
+    arena_allocator(const arena_allocator<U,Align>& other) noexcept
+      : _arena(other.arena()) {}
+
+    /// Reserve memory for n elements
+    pointer allocate(const size_type n) {
+      const size_t bytes = n*sizeof(T);
+      if (_arena != nullptr) {
+        return static_cast<pointer>(_arena->allocate(bytes,Align));
+      }
+      void* ptr = boost::alignment::aligned_alloc(Align,bytes);
+      if (ptr == nullptr) {
+        throw std::bad_alloc();
+      }
+      return static_cast<pointer>(ptr);
+    }
+
+    /// Release the memory of n elements
+    void deallocate(pointer ptr,const size_type n) noexcept {
+      if (_arena != nullptr) {
+        _arena->deallocate(ptr,n*sizeof(T));
+      } else {
+        boost::alignment::aligned_free(ptr);
+      }
+    }
+
+    /// Arena in use, or nullptr for the heap
+    inline Arena* arena() const noexcept { return _arena; }
+
+  private:
+    Arena* _arena;
+  };
+
+  template<class T, class U, std::size_t Align>
+  inline bool operator==(const arena_allocator<T,Align>& a,
+                         const arena_allocator<U,Align>& b) noexcept {
+    return a.arena() == b.arena();
+  }
+
+  template<class T, class U, std::size_t Align>
+  inline bool operator!=(const arena_allocator<T,Align>& a,
+                         const arena_allocator<U,Align>& b) noexcept {
+    return a.arena() != b.arena();
+  }
+
+  /**
+   * This is identical to the arena_allocator, but additionally
+   * requests the alignment of each row of a matrix
+   */
+  template<class T, std::size_t Align=DefaultAlignment>
+  class arena_row_allocator : public arena_allocator<T,Align> {
+  public:
+    /// Inherit all constructors
+    using arena_allocator<T,Align>::arena_allocator;
+
+    arena_row_allocator() noexcept : arena_allocator<T,Align>() {}
+
+    template<class U>
+    arena_row_allocator(const arena_row_allocator<U,Align>& other) noexcept
+      : arena_allocator<T,Align>(other) {}
+
+    /// Change the stored type
+    template<class U>
+    struct rebind {
+      typedef arena_row_allocator<U, Align> other;
+    };
+
+    /// Type to identify this as a row-aligned allocator
+    typedef std::true_type row_aligned;
+  };
+
+  // Specialization for the arena allocator
+  template<typename T, std::size_t A>
+  struct is_aligned_alloc< anpi::arena_allocator<T,A> > {
+    static const bool value = true;
+  };
+
+  // Specialization for the arena_row_allocator
+  template<typename T, std::size_t A>
+  struct is_aligned_alloc< anpi::arena_row_allocator<T,A> > {
+    static const bool value = true;
+  };
+
+}
+
+#endif
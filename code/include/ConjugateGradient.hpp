@@ -0,0 +1,494 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "SparseMatrix.hpp"
+#include "ArenaAllocator.hpp"
+#include "Parallel.hpp"
+#include "Exception.hpp"
+
+#ifndef ANPI_CONJUGATE_GRADIENT_HPP
+#define ANPI_CONJUGATE_GRADIENT_HPP
+
+namespace anpi
+{
+
+/**
+   * Preconditioners available for the conjugate gradient solver
+   */
+enum PreconditionerType
+{
+  /// Plain conjugate gradient
+  NoPreconditioning,
+  /// Scale with the inverse of the diagonal
+  JacobiPreconditioning,
+  /// Incomplete Cholesky factorization without fill-in, IC(0)
+  IncompleteCholeskyPreconditioning
+};
+
+/**
+   * Settings of the conjugate gradient solver
+   */
+template <typename T>
+struct CGSettings
+{
+  inline CGSettings(const PreconditionerType p = IncompleteCholeskyPreconditioning,
+                    const T tol = T(1.0e-10),
+                    const size_t maxIter = 0u)
+      : preconditioner(p), tolerance(tol), maxIterations(maxIter){};
+
+  /// Preconditioner to be used
+  PreconditionerType preconditioner;
+
+  /// Stop when the residual norm falls below tolerance * norm(b)
+  T tolerance;
+
+  /// Maximum number of iterations (zero means the size of the system)
+  size_t maxIterations;
+};
+
+/**
+   * Identity preconditioner: z = r
+   *
+   * The preconditioners accept any vector type with the interface of
+   * std::vector, as the ones used by pcg() for its temporaries.
+   */
+template <typename T>
+class IdentityPreconditioner
+{
+public:
+  inline void setup(const SparseMatrix<T> &) {}
+
+  template <class Vector>
+  inline void apply(const Vector &r, Vector &z) const
+  {
+    z = r;
+  }
+};
+
+/**
+   * Jacobi preconditioner: z = D^-1 r, with D the diagonal of A
+   */
+template <typename T>
+class JacobiPreconditioner
+{
+  /// Inverse of the diagonal elements
+  std::vector<T> _invDiag;
+
+public:
+  void setup(const SparseMatrix<T> &A)
+  {
+    const size_t n = A.rows();
+    _invDiag.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      const T d = A(i, i);
+      if (d == T(0))
+      {
+        throw anpi::Exception("Jacobi preconditioner: zero diagonal element");
+      }
+      _invDiag[i] = T(1) / d;
+    }
+  }
+
+  template <class Vector>
+  void apply(const Vector &r, Vector &z) const
+  {
+    const size_t n = r.size();
+    z.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      z[i] = _invDiag[i] * r[i];
+    }
+  }
+};
+
+/**
+   * Incomplete Cholesky preconditioner IC(0).
+   *
+   * A lower triangular L with the same sparsity pattern as the lower
+   * triangle of A is computed, such that L L^T approximates A.  The
+   * preconditioner applies z = (L L^T)^-1 r with a forward and a
+   * backward substitution.
+   */
+template <typename T>
+class IncompleteCholesky
+{
+  /// Lower triangular factor, with the diagonal as last entry of each row
+  SparseMatrix<T> _L;
+
+public:
+  void setup(const SparseMatrix<T> &A)
+  {
+    const size_t n = A.rows();
+    const std::vector<size_t> &rowPtr = A.rowPtr();
+    const std::vector<size_t> &colIdx = A.colIdx();
+    const std::vector<T> &values = A.values();
+
+    _L.allocate(n, n, (A.nonZeros() + n) / 2);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      for (size_t k = rowPtr[i]; (k < rowPtr[i + 1]) && (colIdx[k] <= i); ++k)
+      {
+        _L.insert(i, colIdx[k], values[k]);
+      }
+    }
+    _L.finalize();
+
+    const std::vector<size_t> &lptr = _L.rowPtr();
+    const std::vector<size_t> &lcol = _L.colIdx();
+    std::vector<T> &lval = _L.values();
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      const size_t begin = lptr[i], end = lptr[i + 1];
+      if ((begin == end) || (lcol[end - 1] != i))
+      {
+        throw anpi::Exception("Incomplete Cholesky: missing diagonal element");
+      }
+
+      for (size_t k = begin; k < end; ++k)
+      {
+        const size_t j = lcol[k];
+
+        // sparse dot product of rows i and j of L, for columns < j
+        T sum = lval[k];
+        size_t a = begin, b = lptr[j];
+        const size_t bend = lptr[j + 1] - 1; // skip diagonal of row j
+        while ((a < k) && (b < bend))
+        {
+          if (lcol[a] < lcol[b])
+            ++a;
+          else if (lcol[b] < lcol[a])
+            ++b;
+          else
+            sum -= lval[a++] * lval[b++];
+        }
+
+        if (j < i)
+        {
+          lval[k] = sum / lval[bend];
+        }
+        else
+        {
+          if (sum <= T(0))
+          {
+            throw anpi::Exception("Incomplete Cholesky: matrix not positive definite");
+          }
+          lval[k] = std::sqrt(sum);
+        }
+      }
+    }
+  }
+
+  template <class Vector>
+  void apply(const Vector &r, Vector &z) const
+  {
+    const size_t n = r.size();
+    const std::vector<size_t> &lptr = _L.rowPtr();
+    const std::vector<size_t> &lcol = _L.colIdx();
+    const std::vector<T> &lval = _L.values();
+
+    z.resize(n);
+
+    // forward substitution L y = r
+    for (size_t i = 0; i < n; ++i)
+    {
+      T sum = r[i];
+      const size_t diag = lptr[i + 1] - 1;
+      for (size_t k = lptr[i]; k < diag; ++k)
+      {
+        sum -= lval[k] * z[lcol[k]];
+      }
+      z[i] = sum / lval[diag];
+    }
+
+    // backward substitution L^T z = y, traversing L by rows
+    for (size_t i = n; i-- > 0;)
+    {
+      const size_t diag = lptr[i + 1] - 1;
+      z[i] /= lval[diag];
+      const T zi = z[i];
+      for (size_t k = lptr[i]; k < diag; ++k)
+      {
+        z[lcol[k]] -= lval[k] * zi;
+      }
+    }
+  }
+};
+
+/**
+   * Preconditioner of a type chosen at runtime, as given by CGSettings.
+   *
+   * Setting it up for a matrix can cost as much as several iterations
+   * (IC(0) factors the matrix), so it is meant to be set up once and
+   * reused for all the systems with the same matrix.
+   */
+template <typename T>
+class CGPreconditioner
+{
+  /// Type set up
+  PreconditionerType _type = NoPreconditioning;
+  /// Used with JacobiPreconditioning
+  JacobiPreconditioner<T> _jacobi;
+  /// Used with IncompleteCholeskyPreconditioning
+  IncompleteCholesky<T> _ic;
+
+public:
+  /// Set up a preconditioner of the given type for A
+  void setup(const SparseMatrix<T> &A, const PreconditionerType type)
+  {
+    _type = type;
+    _jacobi = JacobiPreconditioner<T>();
+    _ic = IncompleteCholesky<T>();
+    switch (type)
+    {
+    case JacobiPreconditioning:
+      _jacobi.setup(A);
+      break;
+    case IncompleteCholeskyPreconditioning:
+      _ic.setup(A);
+      break;
+    default:
+      break;
+    }
+  }
+
+  /// Type of the preconditioner set up
+  inline PreconditionerType type() const { return _type; }
+
+  template <class Vector>
+  void apply(const Vector &r, Vector &z) const
+  {
+    switch (_type)
+    {
+    case JacobiPreconditioning:
+      _jacobi.apply(r, z);
+      break;
+    case IncompleteCholeskyPreconditioning:
+      _ic.apply(r, z);
+      break;
+    default:
+      z = r;
+      break;
+    }
+  }
+};
+
+/**
+   * Preconditioned conjugate gradient for a symmetric positive definite
+   * operator A, like a SparseMatrix.  A only needs the methods rows(),
+   * cols() and multiply(const T* x, T* y), computing y = A x.
+   *
+   * If x has already the size of the system, it is used as initial
+   * guess; otherwise the iteration starts at zero.
+   *
+   * The vectors of the iteration are allocated once per call, from the
+   * current arena of the thread if there is one (see Arena::Scope), so
+   * that a query solved within a scope does not touch the heap.
+   *
+   * @param[in] A a symmetric positive definite operator
+   * @param[in,out] x solution of the system
+   * @param[in] b right hand side
+   * @param[in] M preconditioner, already set up for A
+   * @param[in] tolerance relative residual used as stop criterion
+   * @param[in] maxIterations maximum number of iterations allowed
+   *
+   * @return the number of iterations performed
+   *
+   * @throws anpi::Exception if the method did not converge
+   */
+template <typename T, class Operator, class Precond>
+size_t pcg(const Operator &A,
+           std::vector<T> &x,
+           const std::vector<T> &b,
+           const Precond &M,
+           const T tolerance,
+           const size_t maxIterations)
+{
+  const size_t n = A.rows();
+  if ((A.cols() != n) || (b.size() != n))
+  {
+    throw anpi::Exception("Conjugate gradient: incompatible system sizes");
+  }
+
+  auto dot = [n](const T *u, const T *v) {
+    T sum = T(0);
+    for (size_t i = 0; i < n; ++i)
+      sum += u[i] * v[i];
+    return sum;
+  };
+
+  if (x.size() != n)
+  {
+    x.assign(n, T(0));
+  }
+
+  typedef std::vector<T, arena_allocator<T> > Vector;
+  Vector r(n), z, p, q(n);
+
+  // r = b - A x
+  A.multiply(x.data(), r.data());
+  for (size_t i = 0; i < n; ++i)
+    r[i] = b[i] - r[i];
+
+  const T bnorm = std::sqrt(dot(b.data(), b.data()));
+  const T threshold = tolerance * ((bnorm > T(0)) ? bnorm : T(1));
+
+  if (std::sqrt(dot(r.data(), r.data())) <= threshold)
+    return 0u;
+
+  M.apply(r, z);
+  p = z;
+  T rz = dot(r.data(), z.data());
+
+  for (size_t it = 1; it <= maxIterations; ++it)
+  {
+    A.multiply(p.data(), q.data());
+    const T alpha = rz / dot(p.data(), q.data());
+    for (size_t i = 0; i < n; ++i)
+    {
+      x[i] += alpha * p[i];
+      r[i] -= alpha * q[i];
+    }
+
+    if (std::sqrt(dot(r.data(), r.data())) <= threshold)
+      return it;
+
+    M.apply(r, z);
+    const T rzNew = dot(r.data(), z.data());
+    const T beta = rzNew / rz;
+    rz = rzNew;
+    for (size_t i = 0; i < n; ++i)
+    {
+      p[i] = z[i] + beta * p[i];
+    }
+  }
+
+  throw anpi::Exception("Conjugate gradient did not converge");
+}
+
+/**
+   * Solve Ax=b for a symmetric positive definite sparse matrix A
+   * with the conjugate gradient method and a preconditioner already set
+   * up for A.  The preconditioner of the settings is ignored.
+   *
+   * @return the number of iterations performed
+   */
+template <typename T>
+size_t solveCG(const SparseMatrix<T> &A,
+               std::vector<T> &x,
+               const std::vector<T> &b,
+               const CGPreconditioner<T> &M,
+               const CGSettings<T> &settings = CGSettings<T>())
+{
+  const size_t maxIter = (settings.maxIterations > 0u) ? settings.maxIterations
+                                                        : A.rows();
+  return pcg(A, x, b, M, settings.tolerance, maxIter);
+}
+
+/**
+   * Solve Ax=b for a symmetric positive definite sparse matrix A
+   * with the preconditioned conjugate gradient method.
+   *
+   * @return the number of iterations performed
+   */
+template <typename T>
+size_t solveCG(const SparseMatrix<T> &A,
+               std::vector<T> &x,
+               const std::vector<T> &b,
+               const CGSettings<T> &settings = CGSettings<T>())
+{
+  CGPreconditioner<T> M;
+  M.setup(A, settings.preconditioner);
+  return solveCG(A, x, b, M, settings);
+}
+
+namespace bits
+{
+/// Solve the systems of all right hand sides B[k] in parallel
+template <typename T, class Precond>
+void pcgAll(const SparseMatrix<T> &A,
+            std::vector<std::vector<T> > &X,
+            const std::vector<std::vector<T> > &B,
+            const Precond &M,
+            const T tolerance,
+            const size_t maxIterations)
+{
+  X.resize(B.size());
+  ParallelErrors errors;
+
+  // exceptions cannot leave the parallel region
+  const std::ptrdiff_t count = std::ptrdiff_t(B.size());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (std::ptrdiff_t k = 0; k < count; ++k)
+  {
+    try
+    {
+      pcg(A, X[k], B[k], M, tolerance, maxIterations);
+    }
+    catch (...)
+    {
+      errors.capture();
+    }
+  }
+
+  errors.rethrow();
+}
+} // namespace bits
+
+/**
+   * Solve A X[k] = B[k] for several right hand sides with the
+   * conjugate gradient method and a preconditioner already set up for
+   * A, shared by all systems.  The preconditioner of the settings is
+   * ignored.
+   *
+   * The systems are solved in parallel.  Each X[k] is used as initial
+   * guess if it already has the size of the system.
+   *
+   * @throws anpi::Exception if any of the systems did not converge
+   */
+template <typename T>
+void solveCG(const SparseMatrix<T> &A,
+             std::vector<std::vector<T> > &X,
+             const std::vector<std::vector<T> > &B,
+             const CGPreconditioner<T> &M,
+             const CGSettings<T> &settings = CGSettings<T>())
+{
+  const size_t maxIter = (settings.maxIterations > 0u) ? settings.maxIterations
+                                                        : A.rows();
+  bits::pcgAll(A, X, B, M, settings.tolerance, maxIter);
+}
+
+/**
+   * Solve A X[k] = B[k] for several right hand sides with the
+   * preconditioned conjugate gradient method.
+   *
+   * The preconditioner is set up only once for all systems.
+   *
+   * @throws anpi::Exception if any of the systems did not converge
+   */
+template <typename T>
+void solveCG(const SparseMatrix<T> &A,
+             std::vector<std::vector<T> > &X,
+             const std::vector<std::vector<T> > &B,
+             const CGSettings<T> &settings = CGSettings<T>())
+{
+  CGPreconditioner<T> M;
+  M.setup(A, settings.preconditioner);
+  solveCG(A, X, B, M, settings);
+}
+
+} // namespace anpi
+
+#endif
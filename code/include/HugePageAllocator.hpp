@@ -0,0 +1,263 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#ifndef ANPI_HUGE_PAGE_ALLOCATOR_HPP
+#define ANPI_HUGE_PAGE_ALLOCATOR_HPP
+
+#include <boost/align/aligned_alloc.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Allocator.hpp"
+
+namespace anpi {
+
+  /// Size of the huge pages requested to the operating system
+  static const size_t HugePageSize = size_t(2) << 20;
+
+  /// Size of the normal pages, touched one by one by firstTouch()
+  static const size_t SmallPageSize = size_t(4) << 10;
+
+  /**
+   * Where the physical pages of a block are placed
+   */
+  enum PagePlacement {
+    /// Leave the placement to the operating system
+    DefaultPlacement,
+    /**
+     * Touch the pages in parallel, each thread a contiguous range of
+     * whole huge pages, so that on NUMA systems each range lands on the
+     * node of its thread.  The parallel kernels also give each thread a
+     * contiguous range of rows, so for blocks of many huge pages per
+     * thread most rows are local to the thread processing them; the
+     * ranges only agree up to the huge page at their ends.
+     */
+    FirstTouchPlacement
+  };
+
+  namespace bits {
+
+    /// Round bytes up to a multiple of the huge page size
+    inline size_t hugePageBytes(const size_t bytes) {
+      return (bytes + (HugePageSize-1)) & ~(HugePageSize-1);
+    }
+
+    /// Map a block of huge pages, or return nullptr on failure
+    inline void* mapHugePages(const size_t bytes) {
+#if defined(__linux__)
+      const size_t size = hugePageBytes(bytes);
+
+      // over-map one huge page to align the block to its boundary
+      void* raw = mmap(nullptr,size+HugePageSize,
+                       PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+      if (raw == MAP_FAILED) {
+        return nullptr;
+      }
+
+      const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(raw);
+      const std::uintptr_t first =
+        (begin + (HugePageSize-1)) & ~std::uintptr_t(HugePageSize-1);
+      if (first != begin) {
+        munmap(raw,first-begin);
+      }
+      const size_t tail = HugePageSize - (first-begin);
+      if (tail != 0) {
+        munmap(reinterpret_cast<void*>(first+size),tail);
+      }
+
+      void* ptr = reinterpret_cast<void*>(first);
+#  ifdef MADV_HUGEPAGE
+      madvise(ptr,size,MADV_HUGEPAGE); // just a hint: errors are harmless
+#  endif
+      return ptr;
+#else
+      return boost::alignment::aligned_alloc(HugePageSize,
+                                             hugePageBytes(bytes));
+#endif
+    }
+
+    /// Release a block obtained with mapHugePages
+    inline void unmapHugePages(void* ptr,const size_t bytes) noexcept {
+#if defined(__linux__)
+      munmap(ptr,hugePageBytes(bytes));
+#else
+      (void)bytes;
+      boost::alignment::aligned_free(ptr);
+#endif
+    }
+
+    /**
+     * Fault the pages of a block mapped by mapHugePages(), distributing
+     * whole huge pages statically among the threads.
+     *
+     * The thread owning a huge page writes each of its small pages: the
+     * first write faults the whole huge page if the system grants one,
+     * and the others place the small pages on the same node if not.
+     */
+    inline void firstTouch(void* ptr,const size_t bytes) {
+      char* mem = static_cast<char*>(ptr);
+      const std::ptrdiff_t pages = std::ptrdiff_t(hugePageBytes(bytes)/HugePageSize);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for (std::ptrdiff_t p = 0; p < pages; ++p) {
+        char* page = mem + size_t(p)*HugePageSize;
+        for (size_t offset = 0; offset < HugePageSize; offset += SmallPageSize) {
+          page[offset] = 0;
+        }
+      }
+    }
+  } // namespace bits
+
+  /**
+   * Allocator for large matrices, backed by transparent huge pages.
+   *
+   * Blocks of at least HugePageSize bytes are mapped directly from the
+   * operating system, aligned to a huge page, and marked with
+   * madvise(MADV_HUGEPAGE), which reduces the TLB misses when
+   * traversing large matrices.  Smaller blocks use the normal aligned
+   * heap.  With FirstTouchPlacement the pages of large blocks are
+   * touched by the threads that will later process them.
+   *
+   * The placement is a property of each allocator instance, given
+   * to the Matrix constructors that take an allocator:
+   *
+   * \code
+   * typedef anpi::huge_page_row_allocator<double> alloc;
+   * anpi::Matrix<double,alloc> A(n,n,anpi::DoNotInitialize,
+   *                              alloc(anpi::FirstTouchPlacement));
+   * \endcode
+   */
+  template<class T, std::size_t Align=DefaultAlignment>
+  class huge_page_allocator {
+  public:
+    static_assert((Align & (Align-1)) == 0,"Alignment must be a power of two");
+    static_assert(Align <= HugePageSize,"Alignment larger than a huge page");
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    /// Change the stored type
+    template<class U>
+    struct rebind {
+      typedef huge_page_allocator<U, Align> other;
+    };
+
+    huge_page_allocator() noexcept : _placement(DefaultPlacement) {}
+
+    /// Allocator with the given placement of the pages
+    explicit huge_page_allocator(const PagePlacement placement) noexcept
+      : _placement(placement) {}
+
+    template<class U>
+    huge_page_allocator(const huge_page_allocator<U,Align>& other) noexcept
+      : _placement(other.placement()) {}
+
+    /// Reserve memory for n elements
+    pointer allocate(const size_type n) {
+      const size_t bytes = n*sizeof(T);
+      void* ptr = (bytes >= HugePageSize)
+        ? bits::mapHugePages(bytes)
+        : boost::alignment::aligned_alloc(Align,bytes);
+
+      if (ptr == nullptr) {
+        throw std::bad_alloc();
+      }
+
+      if ((_placement == FirstTouchPlacement) && (bytes >= HugePageSize)) {
+        bits::firstTouch(ptr,bytes);
+      }
+
+      return static_cast<pointer>(ptr);
+    }
+
+    /// Release the memory of n elements
+    void deallocate(pointer ptr,const size_type n) noexcept {
+      const size_t bytes = n*sizeof(T);
+      if (bytes >= HugePageSize) {
+        bits::unmapHugePages(ptr,bytes);
+      } else {
+        boost::alignment::aligned_free(ptr);
+      }
+    }
+
+    /// Placement of the pages of large blocks
+    inline PagePlacement placement() const noexcept { return _placement; }
+
+  private:
+    PagePlacement _placement;
+  };
+
+  // Memory of any instance can be released by any other
+  template<class T, class U, std::size_t Align>
+  inline bool operator==(const huge_page_allocator<T,Align>&,
+                         const huge_page_allocator<U,Align>&) noexcept {
+    return true;
+  }
+
+  template<class T, class U, std::size_t Align>
+  inline bool operator!=(const huge_page_allocator<T,Align>&,
+                         const huge_page_allocator<U,Align>&) noexcept {
+    return false;
+  }
+
+  /**
+   * This is identical to the huge_page_allocator, but additionally
+   * requests the alignment of each row of a matrix
+   */
+  template<class T, std::size_t Align=DefaultAlignment>
+  class huge_page_row_allocator : public huge_page_allocator<T,Align> {
+  public:
+    /// Inherit all constructors
+    using huge_page_allocator<T,Align>::huge_page_allocator;
+
+    huge_page_row_allocator() noexcept : huge_page_allocator<T,Align>() {}
+
+    template<class U>
+    huge_page_row_allocator(const huge_page_row_allocator<U,Align>& other)
+      noexcept : huge_page_allocator<T,Align>(other) {}
+
+    /// Change the stored type
+    template<class U>
+    struct rebind {
+      typedef huge_page_row_allocator<U, Align> other;
+    };
+
+    /// Type to identify this as a row-aligned allocator
+    typedef std::true_type row_aligned;
+  };
+
+  // Specialization for the huge page allocator
+  template<typename T, std::size_t A>
+  struct is_aligned_alloc< anpi::huge_page_allocator<T,A> > {
+    static const bool value = true;
+  };
+
+  // Specialization for the huge_page_row_allocator
+  template<typename T, std::size_t A>
+  struct is_aligned_alloc< anpi::huge_page_row_allocator<T,A> > {
+    static const bool value = true;
+  };
+
+}
+
+#endif
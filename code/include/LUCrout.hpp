@@ -11,13 +11,20 @@
 #include <cmath>
 #include <limits>
 #include <functional>
+#include <algorithm>
 
 #include "Exception.hpp"
 #include "Matrix.hpp"
+#include "Parallel.hpp"
 
 #ifndef ANPI_LU_CROUT_HPP
 #define ANPI_LU_CROUT_HPP
 
+#ifndef ANPI_LU_BLOCK_SIZE
+/// Width of the panels used by the blocked LU decomposition
+#define ANPI_LU_BLOCK_SIZE 64
+#endif
+
 namespace anpi
 {
 
@@ -180,6 +187,180 @@ void luCrout(const Matrix<T> &A,
   } //end of k loop
 } //end LUCrout
 
+namespace bits
+{
+/**
+   * Implementation of luCroutBlocked(), with vv as workspace for the
+   * scaling of each row, so that repeated decompositions of matrices of
+   * the same size do not allocate memory.  A may be a view of a block
+   * of a larger matrix, and LU may use any allocator, like the one of a
+   * matrix mapped to a file.
+   */
+template <typename T, size_t BlockSize, class Alloc>
+void luCroutBlocked(const MatrixView<const T> &A,
+                    Matrix<T, Alloc> &LU,
+                    std::vector<size_t> &permut,
+                    std::vector<T> &vv)
+{
+  static_assert(BlockSize > 0, "Block size of LU decomposition must be positive");
+
+  if (A.rows() != A.cols())
+  {
+    throw anpi::Exception("Matrix for Crout LU decomposition must be square");
+  }
+
+  LU = A;
+  const size_t n = A.rows();
+  permut.resize(n);
+  vv.resize(n); //vv stores the implicit scaling of each row.
+
+  for (size_t i = 0; i < n; ++i)
+    permut[i] = i;
+
+  //Loop over rows to get the implicit scaling info
+  for (size_t i = 0; i < n; ++i)
+  {
+    T big = T(0);
+    const T *row = LU[i];
+    for (size_t j = 0; j < n; ++j)
+      big = std::max(big, T(std::abs(row[j])));
+    if (big == T(0))
+      throw anpi::Exception("A is a singular matrix, unable to decompose into LU");
+    vv[i] = T(1) / big;
+  }
+
+  for (size_t k0 = 0; k0 < n; k0 += BlockSize)
+  {
+    const size_t kb = std::min(k0 + BlockSize, n); //end of the panel
+
+    //decompose the panel, columns k0 to kb-1
+    for (size_t k = k0; k < kb; ++k)
+    {
+      //Search for largest pivot element.
+      T big = T(0);
+      size_t imax = k;
+      for (size_t i = k; i < n; ++i)
+      {
+        const T temp = vv[i] * std::abs(LU[i][k]);
+        if (temp > big)
+        {
+          big = temp;
+          imax = i;
+        }
+      }
+
+      if (k != imax)
+      {
+        std::swap_ranges(LU[imax], LU[imax] + n, LU[k]);
+        std::swap(vv[imax], vv[k]);
+
+        //Interchange the values in the permutation vector
+        const size_t temp = permut[k];
+        permut[k] = imax;
+        permut[imax] = temp;
+      }
+
+      if ((k + 1 < n) && (LU[k][k] == T(0)))
+        throw anpi::Exception("Singular Matrix, pivot element is zero");
+
+      const T *pivotRow = LU[k];
+      for (size_t i = k + 1; i < n; ++i)
+      {
+        T *row = LU[i];
+        const T temp = row[k] /= pivotRow[k];
+        for (size_t j = k + 1; j < kb; ++j)
+          row[j] -= temp * pivotRow[j];
+      }
+    }
+
+    if (kb == n)
+      break;
+
+    //rows of U at the right of the panel, each tile of columns is
+    //independent of the others
+    const long tiles = long((n - kb + BlockSize - 1) / BlockSize);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (long t = 0; t < tiles; ++t)
+    {
+      const size_t j0 = kb + size_t(t) * BlockSize;
+      const size_t jb = std::min(j0 + BlockSize, n);
+      for (size_t k = k0; k < kb; ++k)
+      {
+        const T *pivotRow = LU[k];
+        for (size_t i = k + 1; i < kb; ++i)
+        {
+          T *row = LU[i];
+          const T temp = row[k];
+          for (size_t j = j0; j < jb; ++j)
+            row[j] -= temp * pivotRow[j];
+        }
+      }
+    }
+
+    //trailing submatrix, A22 -= L21 * U12, with the packed matrix
+    //product.  The three blocks do not overlap.
+    const size_t m = n - kb;
+    const size_t w = kb - k0;
+    const Matrix<T, Alloc> &cLU = LU;
+    anpi::multiplyAdd(T(-1),
+                      cLU.block(kb, k0, m, w),
+                      cLU.block(k0, kb, w, m),
+                      T(1),
+                      LU.block(kb, kb, m, m));
+  }
+} //end luCroutBlocked
+} // namespace bits
+
+/**
+   * Blocked version of luCrout().
+   *
+   * The columns are processed in panels of BlockSize columns.  Each
+   * panel is decomposed with the same pivoting strategy of luCrout(),
+   * but the rows at its right are only updated once per panel: first
+   * the rows of the panel itself (a triangular solve), then the
+   * trailing submatrix with A22 -= L21 * U12, computed by the packed
+   * SIMD matrix product anpi::multiplyAdd() on views of LU.
+   *
+   * The pivots are chosen as in luCrout(), but the products are summed
+   * in a different order, so both results differ by rounding errors.
+   *
+   * If compiled with OpenMP, the triangular solve and the matrix
+   * product are distributed among the threads set with
+   * anpi::setThreads().
+   *
+   * The memory of LU and permut is reused if they already have the
+   * right size.
+   *
+   * @param[in] A a square matrix
+   * @param[out] LU matrix encoding the L and U matrices
+   * @param[out] permut permutation vector, as in luCrout()
+   *
+   * @throws anpi::Exception if matrix cannot be decomposed, or input
+   *         matrix is not square.
+   */
+template <typename T, size_t BlockSize = ANPI_LU_BLOCK_SIZE>
+void luCroutBlocked(const Matrix<T> &A,
+                    Matrix<T> &LU,
+                    std::vector<size_t> &permut)
+{
+  std::vector<T> vv;
+  bits::luCroutBlocked<T, BlockSize>(A.view(), LU, permut, vv);
+}
+
+/**
+   * Row swapped with row k at step k of luCrout() or luCroutBlocked().
+   *
+   * The permutation vector stores at position k the row exchanged with
+   * row k, if that row is below k.  Any other value means that no
+   * exchange took place at that step.
+   */
+inline size_t luPivot(const std::vector<size_t> &permut, const size_t k)
+{
+  return (permut[k] > k) ? permut[k] : k;
+}
+
 } // namespace anpi
 // namespace anpi
 
@@ -0,0 +1,214 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#ifndef ANPI_MAPPED_FILE_ALLOCATOR_HPP
+#define ANPI_MAPPED_FILE_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+#define ANPI_HAS_MMAP
+#endif
+
+#include "Allocator.hpp"
+#include "Exception.hpp"
+
+namespace anpi {
+
+  namespace bits {
+
+    /// Directory for the backing files when none is given
+    inline std::string defaultMappedDirectory() {
+      const char* dir = std::getenv("TMPDIR");
+      return ((dir != nullptr) && (*dir != 0)) ? std::string(dir)
+                                               : std::string("/tmp");
+    }
+
+    /**
+     * Map a new file of the given size, created in the directory dir.
+     *
+     * The file is removed from the directory right away, so that its
+     * space is given back to the file system as soon as it is unmapped,
+     * also if the process ends abnormally.
+     *
+     * @return nullptr on failure
+     */
+    inline void* mapNewFile(const std::string& dir,const size_t bytes) {
+#ifdef ANPI_HAS_MMAP
+      std::string name = dir + "/anpi-matrix-XXXXXX";
+      std::vector<char> path(name.begin(),name.end());
+      path.push_back(0);
+
+      const int fd = mkstemp(path.data());
+      if (fd < 0) {
+        return nullptr;
+      }
+      unlink(path.data());
+
+      void* ptr = nullptr;
+      if (ftruncate(fd,off_t(bytes)) == 0) {
+        ptr = mmap(nullptr,bytes,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+        if (ptr == MAP_FAILED) {
+          ptr = nullptr;
+        }
+      }
+      close(fd); // the mapping keeps the file alive
+
+      return ptr;
+#else
+      (void)dir;
+      (void)bytes;
+      throw anpi::Exception("Memory mapped files are not supported");
+#endif
+    }
+
+    /// Release a block obtained with mapNewFile
+    inline void unmapFile(void* ptr,const size_t bytes) noexcept {
+#ifdef ANPI_HAS_MMAP
+      munmap(ptr,bytes);
+#else
+      (void)ptr;
+      (void)bytes;
+#endif
+    }
+  } // namespace bits
+
+  /**
+   * Allocator keeping the elements of a matrix in a file instead of
+   * in memory.
+   *
+   * Each block is a temporary file in the given directory mapped into
+   * the address space.  The operating system loads and writes back its
+   * pages on demand, so that matrices larger than the physical memory
+   * can be used with the usual algorithms.  These are faster if they
+   * traverse the matrix by rows, which are contiguous in the file.  The
+   * row padding of Matrix is kept as in memory.
+   *
+   * All algorithms working on views, like anpi::lu(A.view(),ws) or
+   * anpi::multiplyAdd, accept such matrices directly.  Their results
+   * must be stored with the same allocator to stay out of memory too,
+   * for the LU decomposition in a workspace using it:
+   *
+   * \code
+   * typedef anpi::mapped_file_row_allocator<double> alloc;
+   * anpi::Matrix<double,alloc> A(n,n,anpi::DoNotInitialize,
+   *                              alloc("/scratch"));
+   * ...
+   * anpi::LUWorkspace<double,alloc> ws(alloc("/scratch"));
+   * anpi::lu(A.view(),ws);
+   * \endcode
+   */
+  template<class T, std::size_t Align=DefaultAlignment>
+  class mapped_file_allocator {
+  public:
+    static_assert((Align & (Align-1)) == 0,"Alignment must be a power of two");
+    static_assert(Align <= 4096,"Alignment larger than a page");
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    /// Change the stored type
+    template<class U>
+    struct rebind {
+      typedef mapped_file_allocator<U, Align> other;
+    };
+
+    /// Use the directory in TMPDIR, or /tmp
+    mapped_file_allocator() : _dir(bits::defaultMappedDirectory()) {}
+
+    /// Create the backing files in the given directory
+    explicit mapped_file_allocator(const std::string& dir) : _dir(dir) {}
+
+    template<class U>
+    mapped_file_allocator(const mapped_file_allocator<U,Align>& other)
+      : _dir(other.directory()) {}
+
+    /// Reserve memory for n elements
+    pointer allocate(const size_type n) {
+      void* ptr = bits::mapNewFile(_dir,n*sizeof(T));
+      if (ptr == nullptr) {
+        throw std::bad_alloc();
+      }
+      return static_cast<pointer>(ptr);
+    }
+
+    /// Release the memory of n elements
+    void deallocate(pointer ptr,const size_type n) noexcept {
+      bits::unmapFile(ptr,n*sizeof(T));
+    }
+
+    /// Directory holding the backing files
+    inline const std::string& directory() const noexcept { return _dir; }
+
+  private:
+    std::string _dir;
+  };
+
+  // Memory of any instance can be released by any other
+  template<class T, class U, std::size_t Align>
+  inline bool operator==(const mapped_file_allocator<T,Align>&,
+                         const mapped_file_allocator<U,Align>&) noexcept {
+    return true;
+  }
+
+  template<class T, class U, std::size_t Align>
+  inline bool operator!=(const mapped_file_allocator<T,Align>&,
+                         const mapped_file_allocator<U,Align>&) noexcept {
+    return false;
+  }
+
+  /**
+   * This is identical to the mapped_file_allocator, but additionally
+   * requests the alignment of each row of a matrix
+   */
+  template<class T, std::size_t Align=DefaultAlignment>
+  class mapped_file_row_allocator : public mapped_file_allocator<T,Align> {
+  public:
+    /// Inherit all constructors
+    using mapped_file_allocator<T,Align>::mapped_file_allocator;
+
+    mapped_file_row_allocator() : mapped_file_allocator<T,Align>() {}
+
+    template<class U>
+    mapped_file_row_allocator(const mapped_file_row_allocator<U,Align>& other)
+      : mapped_file_allocator<T,Align>(other) {}
+
+    /// Change the stored type
+    template<class U>
+    struct rebind {
+      typedef mapped_file_row_allocator<U, Align> other;
+    };
+
+    /// Type to identify this as a row-aligned allocator
+    typedef std::true_type row_aligned;
+  };
+
+  // Specialization for the mapped file allocator
+  template<typename T, std::size_t A>
+  struct is_aligned_alloc< anpi::mapped_file_allocator<T,A> > {
+    static const bool value = true;
+  };
+
+  // Specialization for the mapped_file_row_allocator
+  template<typename T, std::size_t A>
+  struct is_aligned_alloc< anpi::mapped_file_row_allocator<T,A> > {
+    static const bool value = true;
+  };
+
+}
+
+#endif
@@ -25,6 +25,7 @@
 
 #include <AnpiConfig.hpp>
 #include <Allocator.hpp>
+#include <MatrixView.hpp>
 
 #include <typeinfo>
 
@@ -38,6 +39,9 @@ enum InitializationType
   DoNotInitialize
 };
 
+template <class E>
+struct MatrixExpression;
+
 /**
    * Row-major matrix class.
    *
@@ -113,6 +117,11 @@ protected:
     _Matrix_impl(allocator_type &&_a) noexcept;
     //@}
 
+    /**
+     * Exchange the storage with _x, but not the allocators: both
+     * allocators must compare equal, so that each can release the
+     * memory of the other.
+     */
     void _swap_data(_Matrix_impl &_x) noexcept;
   };
 
@@ -171,6 +180,17 @@ public:
   Matrix(std::initializer_list<std::initializer_list<value_type>> _lst,
          const allocator_type &_a);
 
+  /**
+     * Evaluate a lazy expression like a + b - c into a new matrix
+     */
+  template <class E>
+  Matrix(const MatrixExpression<E> &_expr);
+
+  /**
+     * Copy the elements of a view, for example a block of another matrix
+     */
+  explicit Matrix(const MatrixView<const T> &_view);
+
   //@}
 
   /**
@@ -186,9 +206,27 @@ public:
 
   /**
      * Move assignment operator
+     *
+     * The memory of other is taken over only if both allocators compare
+     * equal; otherwise its elements are copied.
      */
   Matrix<T, Alloc> &operator=(Matrix<T, Alloc> &&other);
 
+  /**
+     * Evaluate a lazy expression like a + b - c into this matrix, in a
+     * single pass and without temporaries.  The expression may refer to
+     * this matrix.
+     */
+  template <class E>
+  Matrix<T, Alloc> &operator=(const MatrixExpression<E> &expr);
+
+  /**
+     * Copy the elements of a view, reusing the memory of this matrix if
+     * it has already the size of the view.  The view may refer to this
+     * matrix.
+     */
+  Matrix<T, Alloc> &operator=(const MatrixView<const T> &view);
+
   /**
      * Compare two matrices for equality
      *
@@ -229,6 +267,76 @@ public:
              (row * this->_impl._dcols + col));
   }
 
+  /**
+     * @name Views
+     *
+     * Views refer to the elements of this matrix without copying them.
+     * They are invalid after the matrix is reallocated or destroyed.
+     */
+  //@{
+
+  /// View of the whole matrix
+  inline MatrixView<T> view()
+  {
+    return MatrixView<T>(data(), rows(), cols(), dcols());
+  }
+
+  /// Read-only view of the whole matrix
+  inline MatrixView<const T> view() const
+  {
+    return MatrixView<const T>(data(), rows(), cols(), dcols());
+  }
+
+  /**
+     * View of the block with the given size starting at (row,col)
+     *
+     * @throws anpi::Exception if the block exceeds the matrix
+     */
+  inline MatrixView<T> block(const size_t row, const size_t col,
+                             const size_t rows, const size_t cols)
+  {
+    return view().block(row, col, rows, cols);
+  }
+
+  /// Read-only view of a block
+  inline MatrixView<const T> block(const size_t row, const size_t col,
+                                   const size_t rows, const size_t cols) const
+  {
+    return view().block(row, col, rows, cols);
+  }
+
+  /// View of one row as 1 x cols() matrix
+  inline MatrixView<T> rowView(const size_t row) { return view().row(row); }
+
+  /// Read-only view of one row
+  inline MatrixView<const T> rowView(const size_t row) const
+  {
+    return view().row(row);
+  }
+
+  /// View of one column as rows() x 1 matrix, without copying it
+  inline MatrixView<T> columnView(const size_t col)
+  {
+    return view().column(col);
+  }
+
+  /// Read-only view of one column
+  inline MatrixView<const T> columnView(const size_t col) const
+  {
+    return view().column(col);
+  }
+
+  /// View of the transposed matrix
+  inline MatrixView<T> transposed() { return view().transposed(); }
+
+  /// Read-only view of the transposed matrix
+  inline MatrixView<const T> transposed() const
+  {
+    return view().transposed();
+  }
+
+  //@}
+
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
   std::string Dump() const
@@ -255,7 +363,8 @@ public:
   ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
   /**
-     * Swap the contents of the other matrix with this one
+     * Swap the contents of the other matrix with this one, together
+     * with their allocators
      */
   void swap(Matrix<T, Alloc> &other);
 
@@ -360,6 +469,14 @@ public:
   /// Subtract another matrix to this one, and leave the result in here
   Matrix &operator-=(const Matrix &other);
 
+  /// Sum an expression to this matrix, evaluating both in one pass
+  template <class E>
+  Matrix &operator+=(const MatrixExpression<E> &expr);
+
+  /// Subtract an expression from this matrix, evaluating both in one pass
+  template <class E>
+  Matrix &operator-=(const MatrixExpression<E> &expr);
+
   //@}
 
 private:
@@ -383,13 +500,9 @@ private:
 
 /// @name External arithmetic operators for matrices
 //@{
-template <typename T, class Alloc>
-Matrix<T, Alloc> operator+(const Matrix<T, Alloc> &a,
-                           const Matrix<T, Alloc> &b);
 
-template <typename T, class Alloc>
-Matrix<T, Alloc> operator-(const Matrix<T, Alloc> &a,
-                           const Matrix<T, Alloc> &b);
+// operator+ and operator- return lazy expressions, defined in
+// bits/MatrixExpression.hpp
 
 // Tarea 4
 template <typename T, class Alloc>
@@ -400,6 +513,46 @@ Matrix<T, Alloc> operator*(const Matrix<T, Alloc> &a,
 template <typename T, class Alloc>
 std::vector<T> operator*(const Matrix<T, Alloc> &a,
                          const std::vector<T> &b);
+
+/**
+ * Compute y = alpha*a*x + beta*y, without temporaries.  If beta is
+ * zero, y is overwritten even if it holds NaN.
+ *
+ * @throws anpi::Exception if the sizes of x or y do not match a
+ */
+template <typename T, class Alloc>
+void multiplyAdd(const T alpha,
+                 const Matrix<T, Alloc> &a,
+                 const std::vector<T> &x,
+                 const T beta,
+                 std::vector<T> &y);
+
+/**
+ * Compute y = alpha*a*x + beta*y on a view of a matrix, for example a
+ * block or the transposed of a matrix.
+ *
+ * @throws anpi::Exception if the sizes of x or y do not match a
+ */
+template <typename T>
+void multiplyAdd(const T alpha,
+                 const MatrixView<const T> &a,
+                 const std::vector<T> &x,
+                 const T beta,
+                 std::vector<T> &y);
+
+/**
+ * Compute c = alpha*a*b + beta*c on views of matrices, so that blocks
+ * of larger matrices can be updated in place.  c must not overlap a or
+ * b.  If beta is zero, c is overwritten even if it holds NaN.
+ *
+ * @throws anpi::Exception if the sizes do not match
+ */
+template <typename T>
+void multiplyAdd(const T alpha,
+                 const MatrixView<const T> &a,
+                 const MatrixView<const T> &b,
+                 const T beta,
+                 const MatrixView<T> &c);
 //@}
 
 } // namespace anpi
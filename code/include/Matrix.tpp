@@ -9,6 +9,8 @@
  */
 
 #include "bits/MatrixArithmetic.hpp"
+#include "bits/MatrixProduct.hpp"
+#include "bits/MatrixExpression.hpp"
 #include "Exception.hpp"
 
 namespace anpi
@@ -192,6 +194,7 @@ Matrix<T, Alloc>::Matrix(Matrix<T, Alloc> &&_other,
   else
   {
     _create_storage(_other._impl._rows, _other._impl._cols);
+    fill(_other.data());
   }
 }
 
@@ -229,12 +232,73 @@ Matrix<T, Alloc> &Matrix<T, Alloc>::operator=(Matrix<T, Alloc> &&other)
 {
   if (this->data() != other.data())
   { // alias detection first
-    this->_impl._swap_data(other._impl);
+    if (this->_get_allocator() == other._get_allocator())
+    {
+      this->_impl._swap_data(other._impl);
+    }
+    else
+    {
+      // the memory of other can only be released by its own allocator
+      allocate(other._impl._rows, other._impl._cols);
+      fill(other.data());
+    }
   }
   other.clear();
   return *this;
 }
 
+template <typename T, class Alloc>
+template <class E>
+Matrix<T, Alloc>::Matrix(const MatrixExpression<E> &_expr)
+    : Matrix(_expr.self().rows(), _expr.self().cols(), DoNotInitialize)
+{
+  static_assert(std::is_same<Alloc, typename E::allocator_type>::value,
+                "Expression must have the same allocator as the matrix");
+
+  ::anpi::aimpl::assign(*this, _expr);
+}
+
+template <typename T, class Alloc>
+template <class E>
+Matrix<T, Alloc> &Matrix<T, Alloc>::operator=(const MatrixExpression<E> &expr)
+{
+  static_assert(std::is_same<Alloc, typename E::allocator_type>::value,
+                "Expression must have the same allocator as the matrix");
+
+  // the size only changes if this matrix is not part of the expression
+  allocate(expr.self().rows(), expr.self().cols());
+  ::anpi::aimpl::assign(*this, expr);
+
+  return *this;
+}
+
+template <typename T, class Alloc>
+Matrix<T, Alloc>::Matrix(const MatrixView<const T> &_view)
+    : Matrix(_view.rows(), _view.cols(), DoNotInitialize)
+{
+  this->view().assign(_view);
+}
+
+template <typename T, class Alloc>
+Matrix<T, Alloc> &Matrix<T, Alloc>::operator=(const MatrixView<const T> &view)
+{
+  const T *begin = this->data();
+  const T *end = begin + this->_impl.tentries();
+  if ((view.data() >= begin) && (view.data() < end))
+  { // the view refers to this matrix
+    Matrix<T, Alloc> tmp(view.rows(), view.cols(), DoNotInitialize,
+                         this->_get_allocator());
+    tmp.view().assign(view);
+    this->_impl._swap_data(tmp._impl);
+    return *this;
+  }
+
+  allocate(view.rows(), view.cols());
+  this->view().assign(view);
+
+  return *this;
+}
+
 template <typename T, class Alloc>
 bool Matrix<T, Alloc>::operator==(const Matrix<T, Alloc> &other) const
 {
@@ -277,6 +341,8 @@ bool Matrix<T, Alloc>::operator!=(const Matrix<T, Alloc> &other) const
 template <typename T, class Alloc>
 void Matrix<T, Alloc>::swap(Matrix<T, Alloc> &other)
 {
+  // each block of memory stays with the allocator that reserved it
+  std::swap(this->_get_allocator(), other._get_allocator());
   this->_impl._swap_data(other._impl);
 }
 
@@ -472,27 +538,19 @@ Matrix<T, Alloc> &Matrix<T, Alloc>::operator-=(const Matrix<T, Alloc> &other)
 }
 
 template <typename T, class Alloc>
-Matrix<T, Alloc> operator+(const Matrix<T, Alloc> &a,
-                           const Matrix<T, Alloc> &b)
+template <class E>
+Matrix<T, Alloc> &Matrix<T, Alloc>::operator+=(const MatrixExpression<E> &expr)
 {
 
-  assert((a.rows() == b.rows()) && (a.cols() == b.cols()));
-
-  Matrix<T, Alloc> c(a.rows(), a.cols(), anpi::DoNotInitialize);
-  ::anpi::aimpl::add(a, b, c);
-  return c;
+  return *this = *this + expr.self();
 }
 
 template <typename T, class Alloc>
-Matrix<T, Alloc> operator-(const Matrix<T, Alloc> &a,
-                           const Matrix<T, Alloc> &b)
+template <class E>
+Matrix<T, Alloc> &Matrix<T, Alloc>::operator-=(const MatrixExpression<E> &expr)
 {
 
-  assert((a.rows() == b.rows()) && (a.cols() == b.cols()));
-
-  Matrix<T, Alloc> c(a.rows(), a.cols(), anpi::DoNotInitialize);
-  ::anpi::aimpl::subtract(a, b, c);
-  return c;
+  return *this = *this - expr.self();
 }
 
 template <typename T, class Alloc>
@@ -505,22 +563,9 @@ Matrix<T, Alloc> operator*(const Matrix<T, Alloc> &a,
     throw anpi::Exception("amount of columns of the first matrix must be equal to the amount of rows of the second matrix");
   }
 
-  int nrows = a.rows(), ncols = b.cols(), matchingSize = a.cols();
-  Matrix<T, Alloc> n(nrows, ncols, anpi::DoNotInitialize);
-
-  for (int i = 0; i < nrows; ++i)
-  {
-    for (int j = 0; j < ncols; ++j)
-    {
-      T val = T(0);
-      for (int k = 0; k < matchingSize; ++k)
-      {
-        val += a[i][k] * b[k][j];
-      }
-      n[i][j] = val;
-    }
-  }
-  return n;
+  Matrix<T, Alloc> c(a.rows(), b.cols(), anpi::DoNotInitialize);
+  ::anpi::aimpl::multiply(a, b, c);
+  return c;
 }
 
 template <typename T, class Alloc>
@@ -533,21 +578,72 @@ std::vector<T> operator*(const Matrix<T, Alloc> &a,
     throw anpi::Exception("size of vector must be equal to the size of columns");
   }
 
-  int vecsize = b.size();
-  int rows = a.rows();
-  std::vector<T> result;
-  result.resize(rows);
+  std::vector<T> result(a.rows());
+  ::anpi::aimpl::multiply(a, b, result);
+  return result;
+}
+
+template <typename T, class Alloc>
+void multiplyAdd(const T alpha,
+                 const Matrix<T, Alloc> &a,
+                 const std::vector<T> &x,
+                 const T beta,
+                 std::vector<T> &y)
+{
 
-  for (int i = 0; i < rows; ++i)
+  if (a.cols() != x.size())
   {
-    T currentValue = T(0);
-    for (int j = 0; j < vecsize; ++j)
-    {
-      currentValue += a[i][j] * b[j];
-    }
-    result[i] = currentValue;
+    throw anpi::Exception("size of vector must be equal to the size of columns");
   }
 
-  return result;
+  if (a.rows() != y.size())
+  {
+    throw anpi::Exception("size of result vector must be equal to the size of rows");
+  }
+
+  ::anpi::aimpl::multiplyAdd(alpha, a, x, beta, y);
+}
+
+template <typename T>
+void multiplyAdd(const T alpha,
+                 const MatrixView<const T> &a,
+                 const std::vector<T> &x,
+                 const T beta,
+                 std::vector<T> &y)
+{
+
+  if (a.cols() != x.size())
+  {
+    throw anpi::Exception("size of vector must be equal to the size of columns");
+  }
+
+  if (a.rows() != y.size())
+  {
+    throw anpi::Exception("size of result vector must be equal to the size of rows");
+  }
+
+  ::anpi::aimpl::multiplyAdd(alpha, a, x, beta, y);
 }
+
+template <typename T>
+void multiplyAdd(const T alpha,
+                 const MatrixView<const T> &a,
+                 const MatrixView<const T> &b,
+                 const T beta,
+                 const MatrixView<T> &c)
+{
+
+  if (a.cols() != b.rows())
+  {
+    throw anpi::Exception("amount of columns of the first matrix must be equal to the amount of rows of the second matrix");
+  }
+
+  if ((c.rows() != a.rows()) || (c.cols() != b.cols()))
+  {
+    throw anpi::Exception("size of result matrix does not match the product");
+  }
+
+  ::anpi::aimpl::multiplyAdd(alpha, a, b, beta, c);
+}
+
 } // namespace anpi
@@ -0,0 +1,586 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#ifndef ANPI_MATRIX_IO_HPP
+#define ANPI_MATRIX_IO_HPP
+
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ANPI_MATRIX_IO_MMAP
+#endif
+
+#include "Exception.hpp"
+#include "Matrix.hpp"
+
+namespace anpi
+{
+
+/*
+ * Binary format of a matrix file
+ *
+ * The file starts with a header of MatrixFileHeaderSize bytes, followed
+ * by the rows*dcols elements of the matrix exactly as they are in
+ * memory, including the padding of each row, and zeros up to a multiple
+ * of the header size.  Several such records may follow each other in the
+ * same stream (see saveVector() and loadVector()).  Since the header size is
+ * a multiple of the alignment of all allocators, a mapped file provides
+ * the elements with the same alignment as the original matrix, and they
+ * can be used without copying them.
+ *
+ * The header stores, in the byte order of the machine that wrote it:
+ *
+ *   - the magic string "ANPIMAT" and the format version
+ *   - a marker to detect a different byte order
+ *   - a code for the type of the elements and their size in bytes
+ *   - the alignment of the allocator of the saved matrix
+ *   - rows, cols and dcols
+ */
+
+/// Size in bytes of the header of a matrix file
+static const size_t MatrixFileHeaderSize = 64;
+
+namespace bits
+{
+/// Header at the beginning of a matrix file
+struct MatrixFileHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::uint32_t typeCode;
+  std::uint32_t elementSize;
+  std::uint64_t alignment;
+  std::uint64_t rows;
+  std::uint64_t cols;
+  std::uint64_t dcols;
+};
+
+static_assert(sizeof(MatrixFileHeader) <= MatrixFileHeaderSize,
+              "Matrix file header too large");
+
+static const char MatrixFileMagic[8] = {'A', 'N', 'P', 'I', 'M', 'A', 'T', 0};
+static const std::uint32_t MatrixFileVersion = 1;
+static const std::uint32_t MatrixFileByteOrder = 0x01020304;
+
+/// Code identifying the type of the elements in a matrix file
+template <typename T>
+struct matrix_type_code;
+
+template <>
+struct matrix_type_code<float>
+{
+  static constexpr std::uint32_t value = 1;
+};
+template <>
+struct matrix_type_code<double>
+{
+  static constexpr std::uint32_t value = 2;
+};
+template <>
+struct matrix_type_code<std::int32_t>
+{
+  static constexpr std::uint32_t value = 3;
+};
+template <>
+struct matrix_type_code<std::int64_t>
+{
+  static constexpr std::uint32_t value = 4;
+};
+template <>
+struct matrix_type_code<std::uint8_t>
+{
+  static constexpr std::uint32_t value = 5;
+};
+template <>
+struct matrix_type_code<std::complex<float>>
+{
+  static constexpr std::uint32_t value = 6;
+};
+template <>
+struct matrix_type_code<std::complex<double>>
+{
+  static constexpr std::uint32_t value = 7;
+};
+template <>
+struct matrix_type_code<std::uint64_t>
+{
+  static constexpr std::uint32_t value = 8;
+};
+
+/// Header describing a matrix of elements of type T
+template <typename T>
+MatrixFileHeader matrixFileHeader(const size_t rows,
+                                  const size_t cols,
+                                  const size_t dcols,
+                                  const size_t alignment)
+{
+  MatrixFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MatrixFileMagic, sizeof(header.magic));
+  header.version = MatrixFileVersion;
+  header.byteOrder = MatrixFileByteOrder;
+  header.typeCode = matrix_type_code<T>::value;
+  header.elementSize = sizeof(T);
+  header.alignment = alignment;
+  header.rows = rows;
+  header.cols = cols;
+  header.dcols = dcols;
+  return header;
+}
+
+/// Bytes of the payload of a record, padded to keep the next one aligned
+template <typename T>
+std::uint64_t matrixRecordBytes(const MatrixFileHeader &h)
+{
+  const std::uint64_t bytes = h.rows * h.dcols * sizeof(T);
+  return (bytes + (MatrixFileHeaderSize - 1)) / MatrixFileHeaderSize *
+         MatrixFileHeaderSize;
+}
+
+/// Write a header and its payload at the current position of out
+template <typename T>
+void writeMatrixRecord(std::ostream &out,
+                       const MatrixFileHeader &h,
+                       const T *data)
+{
+  char header[MatrixFileHeaderSize] = {};
+  std::memcpy(header, &h, sizeof(h));
+  out.write(header, MatrixFileHeaderSize);
+
+  const size_t bytes = size_t(h.rows * h.dcols) * sizeof(T);
+  if (bytes != 0)
+  {
+    out.write(reinterpret_cast<const char *>(data), std::streamsize(bytes));
+  }
+
+  const char padding[MatrixFileHeaderSize] = {};
+  out.write(padding, std::streamsize(matrixRecordBytes<T>(h) - bytes));
+}
+
+/// Write the header and the payload of a matrix file
+template <typename T>
+void writeMatrixFile(const std::string &filename,
+                     const MatrixFileHeader &h,
+                     const T *data)
+{
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  if (!out)
+  {
+    throw anpi::Exception("Cannot create matrix file " + filename);
+  }
+
+  writeMatrixRecord(out, h, data);
+
+  if (!out)
+  {
+    throw anpi::Exception("Cannot write matrix file " + filename);
+  }
+}
+
+/**
+   * Check that the header describes a valid matrix of elements of type T
+   * with the given size in bytes of the whole file
+   *
+   * @throws anpi::Exception if the header does not fit
+   */
+template <typename T>
+void checkMatrixFileHeader(const MatrixFileHeader &header,
+                           const std::uint64_t fileSize)
+{
+  if (std::memcmp(header.magic, MatrixFileMagic, sizeof(header.magic)) != 0)
+  {
+    throw anpi::Exception("Not a matrix file");
+  }
+  if (header.version != MatrixFileVersion)
+  {
+    throw anpi::Exception("Unsupported version of the matrix file");
+  }
+  if (header.byteOrder != MatrixFileByteOrder)
+  {
+    throw anpi::Exception("Matrix file was written with another byte order");
+  }
+  if ((header.typeCode != matrix_type_code<T>::value) ||
+      (header.elementSize != sizeof(T)))
+  {
+    throw anpi::Exception("Matrix file holds elements of another type");
+  }
+  if ((header.cols > header.dcols) ||
+      (fileSize < MatrixFileHeaderSize +
+                      header.rows * header.dcols * sizeof(T)))
+  {
+    throw anpi::Exception("Matrix file is corrupt or truncated");
+  }
+}
+
+/**
+   * Read and check the header of the record at the current position of
+   * in, leaving in at its payload
+   */
+template <typename T>
+MatrixFileHeader readMatrixRecordHeader(std::istream &in)
+{
+  const std::streamoff start = in.tellg();
+  in.seekg(0, std::ios::end);
+  const std::streamoff end = in.tellg();
+  in.seekg(start, std::ios::beg);
+
+  MatrixFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!in || (start < 0) || (end < start))
+  {
+    throw anpi::Exception("Matrix file is corrupt or truncated");
+  }
+  checkMatrixFileHeader<T>(header, std::uint64_t(end - start));
+
+  in.seekg(start + std::streamoff(MatrixFileHeaderSize), std::ios::beg);
+  return header;
+}
+
+/// Read and check the header of a matrix file, leaving in at the payload
+template <typename T>
+MatrixFileHeader readMatrixFileHeader(std::ifstream &in,
+                                      const std::string &filename)
+{
+  if (!in)
+  {
+    throw anpi::Exception("Cannot open matrix file " + filename);
+  }
+
+  return readMatrixRecordHeader<T>(in);
+}
+} // namespace bits
+
+/**
+   * Save the matrix m into a binary file.
+   *
+   * The elements are written with their padding, so that loading or
+   * mapping the file recovers the layout without any conversion.
+   *
+   * @throws anpi::Exception if the file cannot be written
+   */
+template <typename T, class Alloc>
+void saveMatrix(const std::string &filename,
+                const Matrix<T, Alloc> &m)
+{
+  typedef typename Matrix<T, Alloc>::allocator_type allocator_type;
+  bits::writeMatrixFile(filename,
+                        bits::matrixFileHeader<T>(m.rows(), m.cols(), m.dcols(),
+                                                  extract_alignment<allocator_type>::value),
+                        m.data());
+}
+
+/**
+   * Load a matrix saved with saveMatrix() into m.
+   *
+   * If the padding of the file coincides with the one of m, the
+   * elements are read in a single block; otherwise row by row.
+   *
+   * @throws anpi::Exception if the file cannot be read or holds
+   *         elements of another type
+   */
+template <typename T, class Alloc>
+void loadMatrix(const std::string &filename,
+                Matrix<T, Alloc> &m)
+{
+  std::ifstream in(filename, std::ios::binary);
+  const bits::MatrixFileHeader header =
+      bits::readMatrixFileHeader<T>(in, filename);
+
+  m.allocate(size_t(header.rows), size_t(header.cols));
+
+  if (m.dcols() == header.dcols)
+  {
+    in.read(reinterpret_cast<char *>(m.data()),
+            std::streamsize(m.rows() * m.dcols() * sizeof(T)));
+  }
+  else
+  {
+    const std::streamoff rowBytes = std::streamoff(header.dcols * sizeof(T));
+    for (size_t i = 0; i < m.rows(); ++i)
+    {
+      in.seekg(std::streamoff(MatrixFileHeaderSize) + std::streamoff(i) * rowBytes,
+               std::ios::beg);
+      in.read(reinterpret_cast<char *>(m[i]),
+              std::streamsize(m.cols() * sizeof(T)));
+    }
+  }
+
+  if (!in)
+  {
+    throw anpi::Exception("Cannot read matrix file " + filename);
+  }
+}
+
+/**
+   * Write a vector at the current position of out, in the format of a
+   * matrix with a single column.
+   *
+   * Several vectors can be written one after the other into the same
+   * stream, and read back in the same order with loadVector().
+   *
+   * @throws anpi::Exception if the stream cannot be written
+   */
+template <typename T>
+void saveVector(std::ostream &out,
+                const std::vector<T> &v)
+{
+  bits::writeMatrixRecord(out,
+                          bits::matrixFileHeader<T>(v.size(), 1, 1, sizeof(T)),
+                          v.data());
+  if (!out)
+  {
+    throw anpi::Exception("Cannot write matrix data");
+  }
+}
+
+/**
+   * Read the vector at the current position of in, written with
+   * saveVector(), or the first column of a matrix.  The stream is left
+   * at the next record.
+   *
+   * @throws anpi::Exception if the data cannot be read or holds
+   *         elements of another type
+   */
+template <typename T>
+void loadVector(std::istream &in,
+                std::vector<T> &v)
+{
+  const std::streamoff start = in.tellg();
+  const bits::MatrixFileHeader header = bits::readMatrixRecordHeader<T>(in);
+
+  v.resize(size_t(header.rows));
+  if (header.dcols == 1)
+  {
+    in.read(reinterpret_cast<char *>(v.data()),
+            std::streamsize(v.size() * sizeof(T)));
+  }
+  else
+  {
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+      in.seekg(start + std::streamoff(MatrixFileHeaderSize + i * header.dcols * sizeof(T)),
+               std::ios::beg);
+      in.read(reinterpret_cast<char *>(&v[i]), sizeof(T));
+    }
+  }
+
+  if (!in)
+  {
+    throw anpi::Exception("Cannot read matrix data");
+  }
+
+  in.seekg(start + std::streamoff(MatrixFileHeaderSize +
+                                  bits::matrixRecordBytes<T>(header)),
+           std::ios::beg);
+}
+
+/**
+   * Save a vector in the format of a matrix with a single column, as
+   * needed for instance for the permutation of an LU decomposition.
+   *
+   * @throws anpi::Exception if the file cannot be written
+   */
+template <typename T>
+void saveVector(const std::string &filename,
+                const std::vector<T> &v)
+{
+  bits::writeMatrixFile(filename,
+                        bits::matrixFileHeader<T>(v.size(), 1, 1, sizeof(T)),
+                        v.data());
+}
+
+/**
+   * Load a vector saved with saveVector(), or the first column of a
+   * matrix file
+   *
+   * @throws anpi::Exception if the file cannot be read or holds
+   *         elements of another type
+   */
+template <typename T>
+void loadVector(const std::string &filename,
+                std::vector<T> &v)
+{
+  std::ifstream in(filename, std::ios::binary);
+  if (!in)
+  {
+    throw anpi::Exception("Cannot open matrix file " + filename);
+  }
+  loadVector(in, v);
+}
+
+/**
+   * Matrix file mapped into memory, without copying its elements.
+   *
+   * The elements are accessed through view(), which all algorithms
+   * taking views accept directly, like the solvers with a stored LU
+   * decomposition.  The pages are loaded only when they are used.
+   * Writing through the view changes just this process' copy of the
+   * page, never the file.
+   *
+   * On systems without mmap the elements are read into memory.
+   */
+template <typename T>
+class MappedMatrix
+{
+public:
+  /// Empty mapping
+  MappedMatrix() : _base(nullptr), _bytes(0) {}
+
+  /**
+     * Map the given file saved with saveMatrix()
+     *
+     * @throws anpi::Exception if the file cannot be mapped or holds
+     *         elements of another type
+     */
+  explicit MappedMatrix(const std::string &filename)
+      : _base(nullptr), _bytes(0)
+  {
+    open(filename);
+  }
+
+  MappedMatrix(MappedMatrix<T> &&other) noexcept
+      : _base(other._base), _bytes(other._bytes), _view(other._view),
+        _buffer(std::move(other._buffer))
+  {
+    other._base = nullptr;
+    other._bytes = 0;
+    other._view = MatrixView<T>();
+  }
+
+  MappedMatrix<T> &operator=(MappedMatrix<T> &&other) noexcept
+  {
+    std::swap(_base, other._base);
+    std::swap(_bytes, other._bytes);
+    std::swap(_view, other._view);
+    std::swap(_buffer, other._buffer);
+    return *this;
+  }
+
+  MappedMatrix(const MappedMatrix<T> &) = delete;
+  MappedMatrix<T> &operator=(const MappedMatrix<T> &) = delete;
+
+  ~MappedMatrix() { close(); }
+
+  /**
+     * Map the given file, releasing the previous one
+     *
+     * @throws anpi::Exception if the file cannot be mapped
+     */
+  void open(const std::string &filename);
+
+  /// Release the mapping
+  void close() noexcept;
+
+  /// Number of rows
+  inline size_t rows() const { return _view.rows(); }
+
+  /// Number of columns
+  inline size_t cols() const { return _view.cols(); }
+
+  /// Check if nothing is mapped
+  inline bool empty() const { return _view.empty(); }
+
+  /// View of the mapped elements
+  inline MatrixView<const T> view() const { return _view; }
+
+  /// View of the mapped elements, writable in this process only
+  inline MatrixView<T> view() { return _view; }
+
+  /// Copy the elements into a matrix
+  template <class Alloc>
+  void copyTo(Matrix<T, Alloc> &m) const
+  {
+    m = view();
+  }
+
+private:
+  void *_base;
+  size_t _bytes;
+  MatrixView<T> _view;
+
+  /// Elements read into memory when mmap is not available
+  std::vector<T> _buffer;
+};
+
+template <typename T>
+void MappedMatrix<T>::open(const std::string &filename)
+{
+  close();
+
+  std::ifstream in(filename, std::ios::binary);
+  const bits::MatrixFileHeader header =
+      bits::readMatrixFileHeader<T>(in, filename);
+
+  const size_t entries = size_t(header.rows * header.dcols);
+
+#ifdef ANPI_MATRIX_IO_MMAP
+  in.close();
+
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw anpi::Exception("Cannot open matrix file " + filename);
+  }
+
+  const size_t bytes = MatrixFileHeaderSize + entries * sizeof(T);
+  void *base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping keeps the file open
+
+  if (base == MAP_FAILED)
+  {
+    throw anpi::Exception("Cannot map matrix file " + filename);
+  }
+  _base = base;
+  _bytes = bytes;
+
+  T *data = reinterpret_cast<T *>(static_cast<char *>(base) + MatrixFileHeaderSize);
+#else
+  _buffer.resize(entries);
+  in.read(reinterpret_cast<char *>(_buffer.data()),
+          std::streamsize(entries * sizeof(T)));
+  if (!in)
+  {
+    throw anpi::Exception("Cannot read matrix file " + filename);
+  }
+
+  T *data = _buffer.data();
+#endif
+
+  _view = MatrixView<T>(data, size_t(header.rows), size_t(header.cols),
+                        size_t(header.dcols));
+}
+
+template <typename T>
+void MappedMatrix<T>::close() noexcept
+{
+#ifdef ANPI_MATRIX_IO_MMAP
+  if (_base != nullptr)
+  {
+    munmap(_base, _bytes);
+  }
+#endif
+  _base = nullptr;
+  _bytes = 0;
+  _view = MatrixView<T>();
+  std::vector<T>().swap(_buffer);
+}
+
+} // namespace anpi
+
+#endif
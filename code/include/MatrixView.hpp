@@ -0,0 +1,276 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#ifndef ANPI_MATRIX_VIEW_HPP
+#define ANPI_MATRIX_VIEW_HPP
+
+#include <cstddef>
+#include <cassert>
+#include <string>
+
+#include "Exception.hpp"
+
+namespace anpi
+{
+
+template <typename T>
+class MatrixView;
+
+/**
+   * Read-only view of the elements of a matrix, without owning them.
+   *
+   * A view is just a pointer, a size and two strides: the element (i,j)
+   * is found at data()[i*rowStride() + j*colStride()].  Views of blocks
+   * or rows of an anpi::Matrix have a column stride of one and the
+   * number of columns with padding (the leading dimension) as row
+   * stride.  Transposed views exchange both strides, so that the
+   * columns of the matrix become the rows of the view.
+   *
+   * Views are cheap to copy and must not outlive the memory they refer
+   * to.  A view of modifiable elements, MatrixView<T>, can be used
+   * wherever a MatrixView<const T> is expected.
+   */
+template <typename T>
+class MatrixView<const T>
+{
+public:
+  typedef T value_type;
+
+  /// Empty view
+  MatrixView()
+      : _data(nullptr), _rows(0), _cols(0), _rowStride(0), _colStride(1) {}
+
+  /// View of rows x cols elements with rows separated by ld elements
+  MatrixView(const T *data,
+             const size_t rows,
+             const size_t cols,
+             const size_t ld)
+      : _data(data), _rows(rows), _cols(cols), _rowStride(ld), _colStride(1) {}
+
+  /// View with arbitrary strides between rows and between columns
+  MatrixView(const T *data,
+             const size_t rows,
+             const size_t cols,
+             const size_t rowStride,
+             const size_t colStride)
+      : _data(data), _rows(rows), _cols(cols),
+        _rowStride(rowStride), _colStride(colStride) {}
+
+  /// Number of rows
+  inline size_t rows() const { return _rows; }
+
+  /// Number of columns
+  inline size_t cols() const { return _cols; }
+
+  /// Distance in elements between consecutive rows
+  inline size_t rowStride() const { return _rowStride; }
+
+  /// Distance in elements between consecutive columns
+  inline size_t colStride() const { return _colStride; }
+
+  /// Check if the view has no elements
+  inline bool empty() const { return (_rows == 0) || (_cols == 0); }
+
+  /// Check if the elements of each row are contiguous in memory
+  inline bool contiguousRows() const { return _colStride == 1; }
+
+  /// Pointer to the element (0,0)
+  inline const T *data() const { return _data; }
+
+  /// Element at the given row and column
+  inline const T &operator()(const size_t row, const size_t col) const
+  {
+    assert((row < _rows) && (col < _cols));
+    return _data[row * _rowStride + col * _colStride];
+  }
+
+  /// Pointer to a given row.  Only valid if contiguousRows()
+  inline const T *operator[](const size_t row) const
+  {
+    assert(contiguousRows() && (row < _rows));
+    return _data + row * _rowStride;
+  }
+
+  /**
+     * View of the block of the given size starting at (row,col)
+     *
+     * @throws anpi::Exception if the block does not fit in this view
+     */
+  MatrixView<const T> block(const size_t row,
+                            const size_t col,
+                            const size_t rows,
+                            const size_t cols) const
+  {
+    check(row, col, rows, cols);
+    return MatrixView<const T>(_data + offset(row, col), rows, cols,
+                               _rowStride, _colStride);
+  }
+
+  /// View of one row as a 1 x cols() matrix
+  MatrixView<const T> row(const size_t r) const
+  {
+    return block(r, 0, 1, _cols);
+  }
+
+  /// View of one column as a rows() x 1 matrix
+  MatrixView<const T> column(const size_t c) const
+  {
+    return block(0, c, _rows, 1);
+  }
+
+  /// View of the transposed matrix
+  MatrixView<const T> transposed() const
+  {
+    return MatrixView<const T>(_data, _cols, _rows, _colStride, _rowStride);
+  }
+
+protected:
+  /// Position of the element (row,col) relative to data()
+  inline size_t offset(const size_t row, const size_t col) const
+  {
+    return row * _rowStride + col * _colStride;
+  }
+
+  /// Check that a block fits into this view
+  void check(const size_t row,
+             const size_t col,
+             const size_t rows,
+             const size_t cols) const
+  {
+    if ((row + rows > _rows) || (col + cols > _cols))
+    {
+      throw anpi::Exception("Block exceeds the limits of the matrix");
+    }
+  }
+
+  const T *_data;
+  size_t _rows;
+  size_t _cols;
+  size_t _rowStride;
+  size_t _colStride;
+};
+
+/**
+   * View of modifiable elements of a matrix.
+   *
+   * The constness of the view refers to the view itself: a const
+   * MatrixView<T> still allows to modify the elements it refers to.
+   *
+   * @see MatrixView<const T>
+   */
+template <typename T>
+class MatrixView : public MatrixView<const T>
+{
+public:
+  typedef MatrixView<const T> base_type;
+
+  /// Empty view
+  MatrixView() : base_type() {}
+
+  /// View of rows x cols elements with rows separated by ld elements
+  MatrixView(T *data,
+             const size_t rows,
+             const size_t cols,
+             const size_t ld)
+      : base_type(data, rows, cols, ld) {}
+
+  /// View with arbitrary strides between rows and between columns
+  MatrixView(T *data,
+             const size_t rows,
+             const size_t cols,
+             const size_t rowStride,
+             const size_t colStride)
+      : base_type(data, rows, cols, rowStride, colStride) {}
+
+  /// Pointer to the element (0,0)
+  inline T *data() const { return const_cast<T *>(this->_data); }
+
+  /// Element at the given row and column
+  inline T &operator()(const size_t row, const size_t col) const
+  {
+    assert((row < this->_rows) && (col < this->_cols));
+    return data()[this->offset(row, col)];
+  }
+
+  /// Pointer to a given row.  Only valid if contiguousRows()
+  inline T *operator[](const size_t row) const
+  {
+    assert(this->contiguousRows() && (row < this->_rows));
+    return data() + row * this->_rowStride;
+  }
+
+  /**
+     * View of the block of the given size starting at (row,col)
+     *
+     * @throws anpi::Exception if the block does not fit in this view
+     */
+  MatrixView<T> block(const size_t row,
+                      const size_t col,
+                      const size_t rows,
+                      const size_t cols) const
+  {
+    this->check(row, col, rows, cols);
+    return MatrixView<T>(data() + this->offset(row, col), rows, cols,
+                         this->_rowStride, this->_colStride);
+  }
+
+  /// View of one row as a 1 x cols() matrix
+  MatrixView<T> row(const size_t r) const
+  {
+    return block(r, 0, 1, this->_cols);
+  }
+
+  /// View of one column as a rows() x 1 matrix
+  MatrixView<T> column(const size_t c) const
+  {
+    return block(0, c, this->_rows, 1);
+  }
+
+  /// View of the transposed matrix
+  MatrixView<T> transposed() const
+  {
+    return MatrixView<T>(data(), this->_cols, this->_rows,
+                         this->_colStride, this->_rowStride);
+  }
+
+  /// Set all elements of the view to the given value
+  void fill(const T val) const
+  {
+    for (size_t i = 0; i < this->_rows; ++i)
+    {
+      for (size_t j = 0; j < this->_cols; ++j)
+      {
+        (*this)(i, j) = val;
+      }
+    }
+  }
+
+  /**
+     * Copy the elements of another view of the same size
+     *
+     * @throws anpi::Exception if the sizes differ
+     */
+  void assign(const MatrixView<const T> &other) const
+  {
+    if ((other.rows() != this->_rows) || (other.cols() != this->_cols))
+    {
+      throw anpi::Exception("Views must have the same size");
+    }
+
+    for (size_t i = 0; i < this->_rows; ++i)
+    {
+      for (size_t j = 0; j < this->_cols; ++j)
+      {
+        (*this)(i, j) = other(i, j);
+      }
+    }
+  }
+};
+
+} // namespace anpi
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#ifndef ANPI_PARALLEL_HPP
+#define ANPI_PARALLEL_HPP
+
+#include <cstddef>
+#include <exception>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace anpi
+{
+
+/**
+   * Set the number of threads used by the parallel algorithms.
+   *
+   * A value of zero uses one thread per available processor.  If the
+   * library was compiled without OpenMP (see the CMake option
+   * ANPI_ENABLE_OpenMP) all algorithms run serially and this call has
+   * no effect.
+   */
+inline void setThreads(const size_t threads)
+{
+#ifdef _OPENMP
+  omp_set_num_threads(threads > 0 ? int(threads) : omp_get_num_procs());
+#else
+  (void)threads;
+#endif
+}
+
+/// Number of threads used by the parallel algorithms
+inline size_t threads()
+{
+#ifdef _OPENMP
+  return size_t(omp_get_max_threads());
+#else
+  return 1u;
+#endif
+}
+
+/**
+   * First exception thrown by the iterations of a parallel loop.
+   *
+   * Exceptions cannot leave an OpenMP region, so each iteration catches
+   * everything with catch (...) and records it with capture().  Once
+   * the region has ended, rethrow() throws the recorded exception, if
+   * any, in the calling thread.
+   */
+class ParallelErrors
+{
+public:
+  /// Record the exception being handled, unless another one was first
+  void capture()
+  {
+#ifdef _OPENMP
+#pragma omp critical(anpi_parallel_errors)
+#endif
+    {
+      if (!_error)
+        _error = std::current_exception();
+    }
+  }
+
+  /// Throw the recorded exception, if any
+  void rethrow() const
+  {
+    if (_error)
+      std::rethrow_exception(_error);
+  }
+
+private:
+  std::exception_ptr _error;
+};
+
+} // namespace anpi
+
+#endif
@@ -27,10 +27,226 @@ inline void lu(const anpi::Matrix<T> &A,
                anpi::Matrix<T> &LU,
                std::vector<size_t> &p)
 {
-  anpi::luCrout(A, LU, p);
+  anpi::luCroutBlocked(A, LU, p);
   // anpi::luDoolittle(A, LU, p);
 }
 
+/**
+   * Memory reused by consecutive calls to solveLU(), so that solving
+   * systems of the same size does not allocate memory after the first
+   * call.
+   *
+   * The factors are reserved with the given allocator, so that for
+   * instance a mapped_file_row_allocator keeps them in a file, for
+   * systems larger than the physical memory.
+   */
+template <typename T, class Alloc = anpi::aligned_row_allocator<T> >
+struct LUWorkspace
+{
+  LUWorkspace() {}
+
+  /// Reserve the factors with the given allocator
+  explicit LUWorkspace(const Alloc &alloc) : LU(alloc) {}
+
+  /// Packed L and U factors
+  anpi::Matrix<T, Alloc> LU;
+  /// Permutation vector of the decomposition
+  std::vector<size_t> permut;
+  /// Scaling of each row during the decomposition
+  std::vector<T> scale;
+};
+
+/** faster method used for LU decomposition, reusing the memory of the
+   * given workspace
+   */
+template <typename T, class Alloc>
+inline void lu(const anpi::MatrixView<const T> &A,
+               LUWorkspace<T, Alloc> &ws)
+{
+  anpi::bits::luCroutBlocked<T, ANPI_LU_BLOCK_SIZE>(A, ws.LU, ws.permut, ws.scale);
+}
+
+/** faster method used for LU decomposition, reusing the memory of the
+   * given workspace
+   */
+template <typename T, class AAlloc, class Alloc>
+inline void lu(const anpi::Matrix<T, AAlloc> &A,
+               LUWorkspace<T, Alloc> &ws)
+{
+  anpi::lu(A.view(), ws);
+}
+
+/**
+   * Solve A x = b with the packed LU decomposition of A and its
+   * permutation vector, as returned by anpi::lu().
+   *
+   * The row exchanges are applied to a copy of b in x, followed by the
+   * forward substitution with the unit lower triangle and the backward
+   * substitution with the upper triangle, all in place.  No memory is
+   * allocated if x already has the size of the system.
+   *
+   * @throws anpi::Exception if the size of b does not match
+   */
+template <typename T>
+void luSolve(const anpi::MatrixView<const T> &LU,
+             const std::vector<size_t> &permut,
+             const std::vector<T> &b,
+             std::vector<T> &x)
+{
+  const size_t n = LU.rows();
+  if ((b.size() != n) || (permut.size() != n))
+  {
+    throw anpi::Exception("size of vector must be equal to the size of rows");
+  }
+
+  x = b;
+
+  // apply the row swaps in the order they were performed
+  for (size_t k = 0; k < n; ++k)
+  {
+    const size_t p = anpi::luPivot(permut, k);
+    if (p != k)
+      std::swap(x[k], x[p]);
+  }
+
+  // forward substitution with the unit lower triangle
+  for (size_t i = 0; i < n; ++i)
+  {
+    const T *row = LU.data() + i * LU.rowStride();
+    const size_t cs = LU.colStride();
+    T sum = x[i];
+    for (size_t j = 0; j < i; ++j)
+      sum -= row[j * cs] * x[j];
+    x[i] = sum;
+  }
+
+  // backward substitution with the upper triangle
+  for (size_t i = n; i-- > 0;)
+  {
+    const T *row = LU.data() + i * LU.rowStride();
+    const size_t cs = LU.colStride();
+    T sum = x[i];
+    for (size_t j = i + 1; j < n; ++j)
+      sum -= row[j * cs] * x[j];
+    x[i] = sum / row[i * cs];
+  }
+}
+
+/**
+   * Solve A x = b with the packed LU decomposition of A.
+   *
+   * @see luSolve(const anpi::MatrixView<const T>&,const std::vector<size_t>&,const std::vector<T>&,std::vector<T>&)
+   */
+template <typename T, class Alloc>
+void luSolve(const anpi::Matrix<T, Alloc> &LU,
+             const std::vector<size_t> &permut,
+             const std::vector<T> &b,
+             std::vector<T> &x)
+{
+  anpi::luSolve(LU.view(), permut, b, x);
+}
+
+/**
+   * LU factorization of a dense matrix, computed once and reused to
+   * solve any number of right hand sides with O(n^2) operations each.
+   */
+template <typename T>
+class LUSolver
+{
+public:
+  /**
+     * Decompose A with anpi::lu() and keep the factors
+     *
+     * @throws anpi::Exception if the matrix cannot be decomposed
+     */
+  void factor(const anpi::Matrix<T> &A)
+  {
+    anpi::lu(A, _LU, _permut);
+  }
+
+  /// Check if a factorization is available
+  inline bool factored() const { return !_LU.empty(); }
+
+  /// Size of the factorized system
+  inline size_t rows() const { return _LU.rows(); }
+
+  /// Packed L and U factors
+  inline const anpi::Matrix<T> &LU() const { return _LU; }
+
+  /**
+     * Solve A x = b with the stored factors
+     *
+     * @throws anpi::Exception if the size of b does not match
+     */
+  void solve(const std::vector<T> &b, std::vector<T> &x) const
+  {
+    anpi::luSolve(_LU, _permut, b, x);
+  }
+
+  /**
+     * Solve A X = B for all columns of B with the stored factors.
+     *
+     * The right hand sides are processed together, row by row, as in
+     * the batched forwardSubstitution() and backwardSubstitution().
+     *
+     * @throws anpi::Exception if the number of rows of B does not match
+     */
+  void solve(const anpi::Matrix<T> &B, anpi::Matrix<T> &X) const
+  {
+    const size_t n = _LU.rows(), m = B.cols();
+    if (B.rows() != n)
+    {
+      throw anpi::Exception("Incompatible sizes for LU solver");
+    }
+
+    X = B;
+
+    for (size_t k = 0; k < n; ++k)
+    {
+      const size_t p = anpi::luPivot(_permut, k);
+      if (p != k)
+        std::swap_ranges(X[k], X[k] + m, X[p]);
+    }
+
+    // forward substitution with the unit lower triangle
+    for (size_t i = 0; i < n; ++i)
+    {
+      const T *row = _LU[i];
+      T *xi = X[i];
+      for (size_t j = 0; j < i; ++j)
+      {
+        const T l = row[j];
+        const T *xj = X[j];
+        for (size_t c = 0; c < m; ++c)
+          xi[c] -= l * xj[c];
+      }
+    }
+
+    // backward substitution with the upper triangle
+    for (size_t i = n; i-- > 0;)
+    {
+      const T *row = _LU[i];
+      T *xi = X[i];
+      for (size_t j = i + 1; j < n; ++j)
+      {
+        const T u = row[j];
+        const T *xj = X[j];
+        for (size_t c = 0; c < m; ++c)
+          xi[c] -= u * xj[c];
+      }
+      const T d = T(1) / row[i];
+      for (size_t c = 0; c < m; ++c)
+        xi[c] *= d;
+    }
+  }
+
+private:
+  /// Packed factors
+  anpi::Matrix<T> _LU;
+  /// Permutation vector of the decomposition
+  std::vector<size_t> _permut;
+};
+
 /** method used to create  the permutation matrix given a
    * permutation vector
   **/
@@ -52,63 +268,164 @@ void permutationMatrix(const std::vector<size_t> &p,
 
 /// method used to solve lower triangular matrices
 template <typename T>
-void forwardSubstitution(const anpi::Matrix<T> &L,
+void forwardSubstitution(const anpi::MatrixView<const T> &L,
                          const std::vector<T> &b,
                          std::vector<T> &y)
 {
 
-  int n = L.rows();
+  const size_t n = L.rows();
   std::vector<T> x(n);
-  for (int i = 0; i < n; i++)
+
+  for (size_t m = 0; m < n; m++)
   {
-    x[i] = T(1);
+    T sum = T(0);
+    for (size_t i = 0; i < m; i++)
+    {
+      sum += L(m, i) * x[i];
+    }
+    x[m] = (b[m] - sum) / L(m, m);
   }
 
-  T sum;
+  y = x;
+}
+
+/// method used to solve lower triangular matrices
+template <typename T>
+void forwardSubstitution(const anpi::Matrix<T> &L,
+                         const std::vector<T> &b,
+                         std::vector<T> &y)
+{
+  anpi::forwardSubstitution(L.view(), b, y);
+}
+
+/// method used to solve upper triangular matrices
+template <typename T>
+void backwardSubstitution(const anpi::MatrixView<const T> &U,
+                          const std::vector<T> &y,
+                          std::vector<T> &x)
+{
+  const size_t n = U.cols();
+  std::vector<T> w(n);
 
-  for (int m = 0; m < n; m++)
+  for (size_t i = n; i-- > 0;)
   {
-    sum = T(0);
-    for (int i = 0; i < m; i++)
+    T sum = T(0);
+    for (size_t j = n - 1; j > i; j--)
     {
-      sum += L[m][i] * x[i];
+      sum += U(i, j) * w[j];
     }
-    x[m] = (b[m] - sum) / L[m][m];
+    w[i] = (y[i] - sum) / U(i, i);
   }
 
-  y = x;
+  x = w;
 }
 
 /// method used to solve upper triangular matrices
-template <typename T> //Aqui esta el error
+template <typename T>
 void backwardSubstitution(const anpi::Matrix<T> &U,
                           const std::vector<T> &y,
                           std::vector<T> &x)
 {
-  int n = U.cols();
-  std::vector<T> w;
-  w.resize(n);
+  anpi::backwardSubstitution(U.view(), y, x);
+}
 
-  for (int i = 0; i < n; i++)
+/**
+   * Solve L Y = B for all columns of B at once, with L lower triangular.
+   *
+   * Each column of B is an independent right hand side.  The rows of Y
+   * are computed in order, subtracting from row i the multiples of the
+   * rows already solved, so that the innermost loop runs over the
+   * contiguous right hand sides of a row and is vectorized.
+   */
+template <typename T>
+void forwardSubstitution(const anpi::MatrixView<const T> &L,
+                         const anpi::Matrix<T> &B,
+                         anpi::Matrix<T> &Y)
+{
+  const size_t n = L.rows(), m = B.cols();
+  if ((L.cols() != n) || (B.rows() != n))
   {
-    w[i] = T(1);
+    throw anpi::Exception("Incompatible sizes for forward substitution");
   }
 
-  T sum;
+  Y = B;
+  for (size_t i = 0; i < n; ++i)
+  {
+    T *yi = Y[i];
+    for (size_t j = 0; j < i; ++j)
+    {
+      const T l = L(i, j);
+      if (l == T(0))
+        continue;
+      const T *yj = Y[j];
+      for (size_t c = 0; c < m; ++c)
+        yi[c] -= l * yj[c];
+    }
+    const T d = T(1) / L(i, i);
+    for (size_t c = 0; c < m; ++c)
+      yi[c] *= d;
+  }
+}
+
+/**
+   * Solve L Y = B for all columns of B at once, with L lower triangular.
+   *
+   * @see forwardSubstitution(const anpi::MatrixView<const T>&,const anpi::Matrix<T>&,anpi::Matrix<T>&)
+   */
+template <typename T>
+void forwardSubstitution(const anpi::Matrix<T> &L,
+                         const anpi::Matrix<T> &B,
+                         anpi::Matrix<T> &Y)
+{
+  anpi::forwardSubstitution(L.view(), B, Y);
+}
 
-  w[n - 1] = y[n - 1] / U[n - 1][n - 1];
+/**
+   * Solve U X = Y for all columns of Y at once, with U upper triangular.
+   *
+   * @see forwardSubstitution(const anpi::MatrixView<const T>&,const anpi::Matrix<T>&,anpi::Matrix<T>&)
+   */
+template <typename T>
+void backwardSubstitution(const anpi::MatrixView<const T> &U,
+                          const anpi::Matrix<T> &Y,
+                          anpi::Matrix<T> &X)
+{
+  const size_t n = U.rows(), m = Y.cols();
+  if ((U.cols() != n) || (Y.rows() != n))
+  {
+    throw anpi::Exception("Incompatible sizes for backward substitution");
+  }
 
-  for (int i = (n - 2); i >= 0; i--)
+  X = Y;
+  for (size_t i = n; i-- > 0;)
   {
-    sum = T(0);
-    for (int j = (n - 1); j >= (i + 1); j--)
+    T *xi = X[i];
+    for (size_t j = i + 1; j < n; ++j)
     {
-      sum += U[i][j] * w[j];
+      const T u = U(i, j);
+      if (u == T(0))
+        continue;
+      const T *xj = X[j];
+      for (size_t c = 0; c < m; ++c)
+        xi[c] -= u * xj[c];
     }
-    w[i] = (y[i] - sum) / U[i][i];
+    const T d = T(1) / U(i, i);
+    for (size_t c = 0; c < m; ++c)
+      xi[c] *= d;
   }
+}
 
-  x = w;
+/**
+   * Solve U X = Y for all columns of Y at once, with U upper triangular.
+   *
+   * @see forwardSubstitution(const anpi::MatrixView<const T>&,const anpi::Matrix<T>&,anpi::Matrix<T>&)
+   */
+template <typename T>
+void backwardSubstitution(const anpi::Matrix<T> &U,
+                          const anpi::Matrix<T> &Y,
+                          anpi::Matrix<T> &X)
+{
+  anpi::backwardSubstitution(U.view(), Y, X);
 }
 
 template <typename T>
@@ -129,76 +446,39 @@ void datosMatrix(anpi::Matrix<T> A)
   cout << "----------------------------------------" << endl;
 }
 
+/**
+   * Solve A x = b with the LU decomposition of A.
+   *
+   * The system is solved directly on the packed decomposition; the
+   * memory of the workspace and of x is reused, so that solving systems
+   * of the same size performs no heap allocations after the first call.
+   *
+   * @throws anpi::Exception if A cannot be decomposed or the sizes do not
+   *         match
+   */
+template <typename T, class Alloc>
+bool solveLU(const anpi::Matrix<T> &A,
+             std::vector<T> &x,
+             const std::vector<T> &b,
+             LUWorkspace<T, Alloc> &ws)
+{
+  anpi::lu(A, ws);
+  anpi::luSolve(ws.LU, ws.permut, b, x);
+  return true;
+}
+
+/**
+   * Solve A x = b with the LU decomposition of A.
+   *
+   * @see solveLU(const anpi::Matrix<T>&,std::vector<T>&,const std::vector<T>&,LUWorkspace<T>&)
+   */
 template <typename T>
 bool solveLU(const anpi::Matrix<T> &A,
              std::vector<T> &x,
              const std::vector<T> &b)
 {
-  cout << "Datos de la matriz A" << endl;
-  datosMatrix(A);
-  cout << "                    " << endl;
-  anpi::Matrix<T> LU;
-  std::vector<size_t> p;
-  anpi::lu(A, LU, p);
-
-  anpi::Matrix<T> L;
-  anpi::Matrix<T> U;
-  anpi::unpackDoolittle(LU, L, U);
-
-  anpi::Matrix<T> P;
-  anpi::permutationMatrix(p, P);
-  // // anpi::Matrix<T>PB = P * b; //ERRROR
-  /*cout << "Datos de la matriz A" << endl;
-  datosMatrix(A);
-  cout << "                    " << endl;
-  cout << "Datos de la matriz L" << endl;
-  datosMatrix(L);
-  cout << "                    " << endl;
-  cout << "Datos de la matriz U" << endl;
-  datosMatrix(U);
-  cout << "                    " << endl;
-  cout << "Datos de la matriz P" << endl;
-  datosMatrix(P);
-  cout << "                    " << endl;
-  */
-  std::vector<T> Pb(P.rows());
-
-  // for (int i = 0; i < PB.rows(); i++)
-  // {
-  //   Pb[i] = PB[i][0];
-  // }
-  // x=b;
-  //we permute the b vector to match the permuted A matrix obtained from LU decomposition
-  int n = P.rows();
-  for (int i = 0; i < n; ++i)
-  {
-    int ip = p[i]; //index in the permutation vector
-    Pb[i] = b[ip]; //move the current value to the permuted position
-  }
-  std::vector<T> y;
-  anpi::forwardSubstitution(L, Pb, y);
-  anpi::backwardSubstitution(U, y, x);
-
-  //permute the result to have it ordered
-  T temp;
-  int pidx;
-  for (int i = 0; i < n; ++i)
-  {
-    pidx = p[i];
-    //if the index was permuted
-    if (i != pidx)
-    {
-      //permute x value
-      temp = x[i];
-      x[i] = x[pidx];
-      x[pidx] = temp;
-      //permute index in permutation
-      p[pidx] = pidx;
-      p[i] = i;
-    }
-  }
-
-  return 1;
+  LUWorkspace<T> ws;
+  return anpi::solveLU(A, x, b, ws);
 }
 
 } // namespace anpi
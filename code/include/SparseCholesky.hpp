@@ -0,0 +1,325 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#ifndef ANPI_SPARSE_CHOLESKY_HPP
+#define ANPI_SPARSE_CHOLESKY_HPP
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "SparseMatrix.hpp"
+#include "MatrixIO.hpp"
+#include "Exception.hpp"
+
+namespace anpi
+{
+
+/**
+   * Cholesky factorization A = L L^T of a symmetric positive definite
+   * sparse matrix, computed once and reused to solve any number of
+   * right hand sides.
+   *
+   * L is kept in profile (skyline) storage: row i holds all columns
+   * from the first non-zero column of row i of A up to the diagonal.
+   * The fill-in of the factorization never leaves that profile, so for
+   * the nodal matrix of a rows x cols map, with bandwidth cols, the
+   * factor needs about n*cols entries and each solve costs two
+   * triangular substitutions of that size.
+   */
+template <typename T>
+class SparseCholesky
+{
+public:
+  /**
+     * Compute the factorization of A.  Only the lower triangle of A is
+     * read.
+     *
+     * @throws anpi::Exception if A is not square or not positive definite
+     */
+  void factor(const SparseMatrix<T> &A)
+  {
+    if (A.rows() != A.cols())
+    {
+      throw anpi::Exception("Matrix for Cholesky factorization must be square");
+    }
+
+    const size_t n = A.rows();
+    const std::vector<size_t> &rowPtr = A.rowPtr();
+    const std::vector<size_t> &colIdx = A.colIdx();
+    const std::vector<T> &values = A.values();
+
+    // profile of each row
+    _first.resize(n);
+    _start.resize(n + 1);
+    _start[0] = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      _first[i] = firstColumn(A, i);
+      _start[i + 1] = _start[i] + (i - _first[i] + 1);
+    }
+
+    _values.assign(_start[n], T(0));
+    for (size_t i = 0; i < n; ++i)
+    {
+      for (size_t k = rowPtr[i]; (k < rowPtr[i + 1]) && (colIdx[k] <= i); ++k)
+      {
+        at(i, colIdx[k]) = values[k];
+      }
+    }
+
+    // row by row: L(i,j) = (A(i,j) - sum_k L(i,k) L(j,k)) / L(j,j)
+    for (size_t i = 0; i < n; ++i)
+    {
+      T *li = &at(i, _first[i]);
+      for (size_t j = _first[i]; j <= i; ++j)
+      {
+        const size_t k0 = std::max(_first[i], _first[j]);
+        const T *lik = li + (k0 - _first[i]);
+        const T *ljk = &at(j, k0);
+        T sum = li[j - _first[i]];
+        for (size_t k = k0; k < j; ++k)
+        {
+          sum -= *lik++ * *ljk++;
+        }
+
+        if (j < i)
+        {
+          li[j - _first[i]] = sum / at(j, j);
+        }
+        else
+        {
+          if (sum <= T(0))
+          {
+            throw anpi::Exception("Cholesky: matrix not positive definite");
+          }
+          li[j - _first[i]] = std::sqrt(sum);
+        }
+      }
+    }
+  }
+
+  /**
+     * Number of entries factor(A) stores for the profile of A, without
+     * allocating them.  For the nodal matrix of a rows x cols map these
+     * are about rows*cols*cols.
+     */
+  static size_t profileEntries(const SparseMatrix<T> &A)
+  {
+    size_t entries = 0;
+    for (size_t i = 0; i < A.rows(); ++i)
+    {
+      entries += i - firstColumn(A, i) + 1;
+    }
+    return entries;
+  }
+
+  /// Check if a factorization is available
+  inline bool factored() const { return !_first.empty(); }
+
+  /// Size of the factorized system
+  inline size_t rows() const { return _first.size(); }
+
+  /// Number of entries stored in the factor
+  inline size_t entries() const { return _values.size(); }
+
+  /**
+     * Check if the stored factor has the profile that factor(A) would
+     * give, e.g. to validate a factorization read with load().  This
+     * takes a single pass over the rows of A.
+     */
+  bool hasProfileOf(const SparseMatrix<T> &A) const
+  {
+    if ((A.rows() != A.cols()) || (A.rows() != _first.size()))
+      return false;
+
+    for (size_t i = 0; i < _first.size(); ++i)
+    {
+      if (firstColumn(A, i) != _first[i])
+        return false;
+    }
+    return true;
+  }
+
+  /**
+     * Solve A x = b with the stored factorization
+     *
+     * @throws anpi::Exception if the size of b does not match
+     */
+  void solve(const std::vector<T> &b, std::vector<T> &x) const
+  {
+    const size_t n = rows();
+    if (b.size() != n)
+    {
+      throw anpi::Exception("size of vector must be equal to the size of rows");
+    }
+
+    x = b;
+
+    // forward substitution L y = b
+    for (size_t i = 0; i < n; ++i)
+    {
+      const T *li = &at(i, _first[i]);
+      T sum = x[i];
+      for (size_t k = _first[i]; k < i; ++k)
+      {
+        sum -= *li++ * x[k];
+      }
+      x[i] = sum / *li;
+    }
+
+    // backward substitution L^T x = y, traversing L by rows
+    for (size_t i = n; i-- > 0;)
+    {
+      const T *li = &at(i, _first[i]);
+      x[i] /= li[i - _first[i]];
+      const T xi = x[i];
+      for (size_t k = _first[i]; k < i; ++k)
+      {
+        x[k] -= *li++ * xi;
+      }
+    }
+  }
+
+  /**
+     * Solve A X = B with the stored factorization for all columns of B
+     * at once.  The factor is traversed only once for all right hand
+     * sides, and the innermost loops run along the rows of X.
+     *
+     * @throws anpi::Exception if the number of rows of B does not match
+     */
+  void solve(const Matrix<T> &B, Matrix<T> &X) const
+  {
+    const size_t n = rows();
+    if (B.rows() != n)
+    {
+      throw anpi::Exception("size of vector must be equal to the size of rows");
+    }
+
+    X = B;
+    const size_t m = X.cols();
+
+    // forward substitution L Y = B
+    for (size_t i = 0; i < n; ++i)
+    {
+      const T *li = &at(i, _first[i]);
+      T *xi = X[i];
+      for (size_t k = _first[i]; k < i; ++k)
+      {
+        const T lik = *li++;
+        const T *xk = X[k];
+        for (size_t j = 0; j < m; ++j)
+        {
+          xi[j] -= lik * xk[j];
+        }
+      }
+      const T d = *li;
+      for (size_t j = 0; j < m; ++j)
+      {
+        xi[j] /= d;
+      }
+    }
+
+    // backward substitution L^T X = Y, traversing L by rows
+    for (size_t i = n; i-- > 0;)
+    {
+      const T *li = &at(i, _first[i]);
+      T *xi = X[i];
+      const T d = li[i - _first[i]];
+      for (size_t j = 0; j < m; ++j)
+      {
+        xi[j] /= d;
+      }
+      for (size_t k = _first[i]; k < i; ++k)
+      {
+        const T lik = *li++;
+        T *xk = X[k];
+        for (size_t j = 0; j < m; ++j)
+        {
+          xk[j] -= lik * xi[j];
+        }
+      }
+    }
+  }
+
+  /**
+     * Write the factorization into a binary stream, with the format
+     * of MatrixIO.hpp.  The indices are stored as 64 bit integers, so
+     * that the size of size_t on the platform does not change the
+     * format.
+     *
+     * @throws anpi::Exception if the stream cannot be written
+     */
+  void save(std::ostream &out) const
+  {
+    anpi::saveVector(out, std::vector<std::uint64_t>(_first.begin(), _first.end()));
+    anpi::saveVector(out, std::vector<std::uint64_t>(_start.begin(), _start.end()));
+    anpi::saveVector(out, _values);
+  }
+
+  /**
+     * Read a factorization written with save()
+     *
+     * @throws anpi::Exception if the data is invalid
+     */
+  void load(std::istream &in)
+  {
+    std::vector<std::uint64_t> first, start;
+    std::vector<T> values;
+    anpi::loadVector(in, first);
+    anpi::loadVector(in, start);
+    anpi::loadVector(in, values);
+
+    const std::uint64_t n = first.size();
+    bool valid = (start.size() == n + 1) && (start[0] == 0) &&
+                 (start[n] == values.size());
+    for (std::uint64_t i = 0; valid && (i < n); ++i)
+    {
+      valid = (first[i] <= i) && (start[i + 1] == start[i] + (i - first[i] + 1));
+    }
+    if (!valid)
+    {
+      throw anpi::Exception("Cholesky: invalid stored factorization");
+    }
+
+    _first.assign(first.begin(), first.end());
+    _start.assign(start.begin(), start.end());
+    _values.swap(values);
+  }
+
+private:
+  /// First column of the profile of row i of A
+  static size_t firstColumn(const SparseMatrix<T> &A, const size_t i)
+  {
+    const size_t begin = A.rowPtr()[i];
+    return ((begin < A.rowPtr()[i + 1]) && (A.colIdx()[begin] < i)) ? A.colIdx()[begin] : i;
+  }
+
+  /// First column stored for each row
+  std::vector<size_t> _first;
+  /// Offset of the first stored entry of each row
+  std::vector<size_t> _start;
+  /// Entries of L, row by row
+  std::vector<T> _values;
+
+  /// Entry (i,j) of L, for _first[i] <= j <= i
+  inline T &at(const size_t i, const size_t j)
+  {
+    return _values[_start[i] + (j - _first[i])];
+  }
+
+  /// Entry (i,j) of L, for _first[i] <= j <= i
+  inline const T &at(const size_t i, const size_t j) const
+  {
+    return _values[_start[i] + (j - _first[i])];
+  }
+};
+
+} // namespace anpi
+
+#endif
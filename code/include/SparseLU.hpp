@@ -0,0 +1,188 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "SparseMatrix.hpp"
+#include "ArenaAllocator.hpp"
+#include "Exception.hpp"
+
+#ifndef ANPI_SPARSE_LU_HPP
+#define ANPI_SPARSE_LU_HPP
+
+namespace anpi
+{
+
+/**
+   * Solve the equation system Ax=b for a sparse square matrix A.
+   *
+   * Gaussian elimination with partial pivoting is applied directly on
+   * the sparse rows of A, which are kept as sorted lists of non-zero
+   * entries.  Only the fill-in produced by the elimination is added to
+   * those lists, so that the memory required grows with the number of
+   * non-zero entries of the factorization and not with n^2 as in the
+   * dense solveLU.
+   *
+   * The rows are many small lists that grow with the fill-in.  They are
+   * allocated from the current arena of the thread if there is one (see
+   * Arena::Scope), where allocating them costs no more than a bump of a
+   * pointer and all of them are released at once.
+   *
+   * @param[in] A a finalized square sparse matrix
+   * @param[out] x solution of the system
+   * @param[in] b right hand side of the system
+   *
+   * @throws anpi::Exception if the matrix is not square or singular
+   */
+template <typename T>
+bool solveSparseLU(const SparseMatrix<T> &A,
+                   std::vector<T> &x,
+                   const std::vector<T> &b)
+{
+  if (A.rows() != A.cols())
+  {
+    throw anpi::Exception("Matrix for sparse LU solver must be square");
+  }
+  if (A.rows() != b.size())
+  {
+    throw anpi::Exception("size of vector must be equal to the size of rows");
+  }
+
+  const size_t n = A.rows();
+
+  typedef std::vector<size_t, arena_allocator<size_t, alignof(size_t)> > Indices;
+  typedef std::vector<T, arena_allocator<T, alignof(T)> > Values;
+
+  // working copy of each row, as sorted lists of columns and values
+  std::vector<Indices, arena_allocator<Indices, alignof(Indices)> > cols(n);
+  std::vector<Values, arena_allocator<Values, alignof(Values)> > vals(n);
+
+  // rows that (may) hold a non-zero entry in each column
+  std::vector<Indices, arena_allocator<Indices, alignof(Indices)> > colRows(n);
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    const size_t begin = A.rowPtr()[i], end = A.rowPtr()[i + 1];
+    cols[i].assign(A.colIdx().begin() + begin, A.colIdx().begin() + end);
+    vals[i].assign(A.values().begin() + begin, A.values().begin() + end);
+    for (size_t k = begin; k < end; ++k)
+    {
+      colRows[A.colIdx()[k]].push_back(i);
+    }
+  }
+
+  Values rhs(b.begin(), b.end());
+  std::vector<char, arena_allocator<char, alignof(char)> > eliminated(n, 0);
+  Indices pivotRow(n);
+
+  // value of the entry at column k of row r, or zero if not present
+  auto entry = [&](const size_t r, const size_t k) -> T {
+    const auto pos = std::lower_bound(cols[r].begin(), cols[r].end(), k);
+    return ((pos != cols[r].end()) && (*pos == k)) ? vals[r][pos - cols[r].begin()]
+                                                  : T(0);
+  };
+
+  Indices mcols;
+  Values mvals;
+
+  for (size_t k = 0; k < n; ++k)
+  {
+    //Search for largest pivot element among the remaining rows
+    size_t p = n;
+    T big = T(0), temp;
+    for (const size_t r : colRows[k])
+    {
+      if (!eliminated[r] && ((temp = std::abs(entry(r, k))) > big))
+      {
+        big = temp;
+        p = r;
+      }
+    }
+    if (p == n)
+    {
+      throw anpi::Exception("Singular Matrix, pivot element is zero");
+    }
+
+    eliminated[p] = 1;
+    pivotRow[k] = p;
+
+    // the pivot row holds only columns >= k, being k the first one
+    const T pivot = vals[p].front();
+    const Indices &pcols = cols[p];
+    const Values &pvals = vals[p];
+
+    //eliminate column k in all remaining rows
+    for (const size_t r : colRows[k])
+    {
+      if (eliminated[r])
+        continue;
+
+      // the row may be listed twice, or its entry may have cancelled
+      if (cols[r].empty() || (cols[r].front() != k))
+        continue;
+
+      const T factor = vals[r].front() / pivot;
+      rhs[r] -= factor * rhs[p];
+
+      // merge row r (without column k) with -factor times the pivot row
+      mcols.clear();
+      mvals.clear();
+      size_t ri = 1, pi = 1;
+      const size_t rn = cols[r].size(), pn = pcols.size();
+      while ((ri < rn) || (pi < pn))
+      {
+        if ((pi == pn) || ((ri < rn) && (cols[r][ri] < pcols[pi])))
+        {
+          mcols.push_back(cols[r][ri]);
+          mvals.push_back(vals[r][ri++]);
+        }
+        else if ((ri == rn) || (pcols[pi] < cols[r][ri]))
+        {
+          // fill-in: row r gets a new entry in this column
+          colRows[pcols[pi]].push_back(r);
+          mcols.push_back(pcols[pi]);
+          mvals.push_back(-factor * pvals[pi++]);
+        }
+        else
+        {
+          const T val = vals[r][ri++] - factor * pvals[pi];
+          if (val != T(0))
+          {
+            mcols.push_back(pcols[pi]);
+            mvals.push_back(val);
+          }
+          ++pi;
+        }
+      }
+      cols[r].swap(mcols);
+      vals[r].swap(mvals);
+    }
+
+    // this column is done
+    Indices().swap(colRows[k]);
+  }
+
+  // back substitution with the upper triangular pivot rows
+  x.resize(n);
+  for (size_t k = n; k-- > 0;)
+  {
+    const size_t p = pivotRow[k];
+    T sum = rhs[p];
+    for (size_t j = 1; j < cols[p].size(); ++j)
+    {
+      sum -= vals[p][j] * x[cols[p][j]];
+    }
+    x[k] = sum / vals[p].front();
+  }
+
+  return true;
+}
+
+} // namespace anpi
+
+#endif
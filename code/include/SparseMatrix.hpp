@@ -0,0 +1,200 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#ifndef ANPI_SPARSE_MATRIX_HPP
+#define ANPI_SPARSE_MATRIX_HPP
+
+#include <cstddef>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+
+#include <Matrix.hpp>
+#include <Exception.hpp>
+
+namespace anpi
+{
+/**
+   * Sparse matrix stored in compressed sparse row (CSR) format.
+   *
+   * Only the non-zero entries are kept in memory.  The entries of the
+   * i-th row are located at the positions rowPtr()[i] up to
+   * rowPtr()[i+1]-1 of the arrays values() and colIdx(), where the
+   * latter holds the column of each entry, sorted in ascending order.
+   *
+   * The matrix is assembled row by row with insert().  The rows must be
+   * filled in non-decreasing order, but within one row the columns can
+   * be given in any order.  Once all entries have been inserted,
+   * finalize() must be called to close the remaining rows before the
+   * matrix can be used in any computation.
+   *
+   * If the number of entries of each row is known in advance, the
+   * matrix can instead be prepared with allocateRows() and its rows
+   * filled with setRow() in any order, e.g. in parallel.
+   */
+template <typename T>
+class SparseMatrix
+{
+public:
+  /// Type of the stored elements
+  typedef T value_type;
+
+  /**
+     * @name Constructors
+     */
+  //@{
+  SparseMatrix();
+
+  /**
+     * Create an empty rows x cols matrix, reserving space for the
+     * given number of non-zero entries
+     */
+  explicit SparseMatrix(const size_t rows,
+                        const size_t cols,
+                        const size_t nonZeros = 0u);
+  //@}
+
+  /**
+     * Reset the matrix to an empty rows x cols matrix, reserving space
+     * for the given number of non-zero entries.
+     */
+  void allocate(const size_t rows,
+                const size_t cols,
+                const size_t nonZeros = 0u);
+
+  /**
+     * Reset this matrix to a default constructed empty state
+     */
+  void clear();
+
+  /**
+     * Set the value of the element at the given row and column.
+     *
+     * The row must be greater or equal than the row of any previously
+     * inserted element.  If the element already exists, its value is
+     * replaced.
+     */
+  void insert(const size_t row, const size_t col, const T val);
+
+  /**
+     * Close all rows not yet touched by insert().  After this call no
+     * more elements can be inserted.
+     */
+  void finalize();
+
+  /**
+     * Reset the matrix to an empty matrix with rowNonZeros.size() rows
+     * and the given columns, reserving the given number of entries in
+     * each row.
+     *
+     * The matrix is already finalized: the entries of each row are
+     * then written with setRow(), for the rows in any order.  Since each
+     * row owns a fixed part of the storage, several threads can fill
+     * different rows at the same time.
+     */
+  void allocateRows(const size_t cols,
+                    const std::vector<size_t> &rowNonZeros);
+
+  /**
+     * Set all entries of a row of a matrix prepared with allocateRows().
+     *
+     * The arrays hold the columns, in ascending order, and the values of
+     * as many entries as were reserved for the row.
+     */
+  inline void setRow(const size_t row, const size_t *cols, const T *vals)
+  {
+    assert(row < _rows);
+    const size_t begin = _rowPtr[row], end = _rowPtr[row + 1];
+    for (size_t k = begin; k < end; ++k)
+    {
+      assert((k == begin) || (cols[k - begin] > cols[k - begin - 1]));
+      assert(cols[k - begin] < _cols);
+      _colIdx[k] = cols[k - begin];
+      _values[k] = vals[k - begin];
+    }
+  }
+
+  /**
+     * Check if finalize() has already been called
+     */
+  inline bool finalized() const { return _last == _rows; }
+
+  /// Return the element at the given row and column (zero if not stored)
+  T operator()(const size_t row, const size_t col) const;
+
+  /// Number of rows
+  inline size_t rows() const { return _rows; }
+
+  /// Number of columns
+  inline size_t cols() const { return _cols; }
+
+  /// Number of stored (non-zero) entries
+  inline size_t nonZeros() const { return _values.size(); }
+
+  /// Check if the matrix is empty (zero rows or columns)
+  inline bool empty() const { return (_rows == 0) || (_cols == 0); }
+
+  /// Row pointers: offset of the first entry of each row (rows()+1 entries)
+  inline const std::vector<size_t> &rowPtr() const { return _rowPtr; }
+
+  /// Column of each stored entry
+  inline const std::vector<size_t> &colIdx() const { return _colIdx; }
+
+  /// Value of each stored entry
+  inline const std::vector<T> &values() const { return _values; }
+
+  /// Writable access to the values, keeping the sparsity pattern
+  inline std::vector<T> &values() { return _values; }
+
+  /**
+     * Compute y = A x, for arrays x of cols() and y of rows() elements.
+     * Unlike operator*, this writes into existing storage.
+     */
+  void multiply(const T *x, T *y) const;
+
+  /**
+     * Expand this matrix into a dense one.
+     *
+     * This is only intended for debugging purposes, as the dense
+     * matrix requires rows() x cols() elements.
+     */
+  template <class Alloc>
+  void toDense(Matrix<T, Alloc> &dense) const;
+
+private:
+  /// Number of rows
+  size_t _rows;
+
+  /// Number of columns
+  size_t _cols;
+
+  /// Row currently being filled by insert()
+  size_t _last;
+
+  /// Offset of the first element of each row
+  std::vector<size_t> _rowPtr;
+
+  /// Column index of each element
+  std::vector<size_t> _colIdx;
+
+  /// Value of each element
+  std::vector<T> _values;
+}; // class SparseMatrix
+
+/// @name External arithmetic operators for sparse matrices
+//@{
+template <typename T>
+std::vector<T> operator*(const SparseMatrix<T> &a,
+                         const std::vector<T> &b);
+//@}
+
+} // namespace anpi
+
+// include the template implementations
+#include "SparseMatrix.tpp"
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+namespace anpi
+{
+
+// ------------------------------
+// Implementation of SparseMatrix
+// ------------------------------
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix()
+    : _rows(0), _cols(0), _last(0), _rowPtr(1, 0u) {}
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(const size_t rows,
+                              const size_t cols,
+                              const size_t nonZeros)
+    : SparseMatrix()
+{
+  allocate(rows, cols, nonZeros);
+}
+
+template <typename T>
+void SparseMatrix<T>::allocate(const size_t rows,
+                               const size_t cols,
+                               const size_t nonZeros)
+{
+  _rows = rows;
+  _cols = cols;
+  _last = 0;
+
+  _rowPtr.assign(rows + 1, 0u);
+  _colIdx.clear();
+  _values.clear();
+  _colIdx.reserve(nonZeros);
+  _values.reserve(nonZeros);
+}
+
+template <typename T>
+void SparseMatrix<T>::allocateRows(const size_t cols,
+                                   const std::vector<size_t> &rowNonZeros)
+{
+  _rows = rowNonZeros.size();
+  _cols = cols;
+  _last = _rows;
+
+  _rowPtr.resize(_rows + 1);
+  _rowPtr[0] = 0u;
+  for (size_t i = 0; i < _rows; ++i)
+  {
+    _rowPtr[i + 1] = _rowPtr[i] + rowNonZeros[i];
+  }
+
+  _colIdx.assign(_rowPtr[_rows], 0u);
+  _values.assign(_rowPtr[_rows], T(0));
+}
+
+template <typename T>
+void SparseMatrix<T>::clear()
+{
+  allocate(0, 0);
+}
+
+template <typename T>
+void SparseMatrix<T>::insert(const size_t row,
+                             const size_t col,
+                             const T val)
+{
+  assert((row < _rows) && (col < _cols));
+  assert((row >= _last) && "Rows must be filled in non-decreasing order");
+
+  // close all rows between the last one touched and the current one
+  while (_last < row)
+  {
+    _rowPtr[++_last] = _values.size();
+  }
+
+  // keep the columns of the current row sorted
+  const auto begin = _colIdx.begin() + _rowPtr[row];
+  const auto pos = std::lower_bound(begin, _colIdx.end(), col);
+  const size_t off = pos - _colIdx.begin();
+
+  if ((pos != _colIdx.end()) && (*pos == col))
+  {
+    _values[off] = val;
+  }
+  else
+  {
+    _colIdx.insert(pos, col);
+    _values.insert(_values.begin() + off, val);
+  }
+}
+
+template <typename T>
+void SparseMatrix<T>::finalize()
+{
+  while (_last < _rows)
+  {
+    _rowPtr[++_last] = _values.size();
+  }
+}
+
+template <typename T>
+T SparseMatrix<T>::operator()(const size_t row, const size_t col) const
+{
+  assert(finalized() && (row < _rows) && (col < _cols));
+
+  const auto begin = _colIdx.begin() + _rowPtr[row];
+  const auto end = _colIdx.begin() + _rowPtr[row + 1];
+  const auto pos = std::lower_bound(begin, end, col);
+
+  return ((pos != end) && (*pos == col)) ? _values[pos - _colIdx.begin()]
+                                         : T(0);
+}
+
+template <typename T>
+template <class Alloc>
+void SparseMatrix<T>::toDense(Matrix<T, Alloc> &dense) const
+{
+  assert(finalized());
+
+  dense.allocate(_rows, _cols);
+  dense.fill(T(0));
+
+  for (size_t i = 0; i < _rows; ++i)
+  {
+    T *row = dense[i];
+    for (size_t k = _rowPtr[i]; k < _rowPtr[i + 1]; ++k)
+    {
+      row[_colIdx[k]] = _values[k];
+    }
+  }
+}
+
+template <typename T>
+void SparseMatrix<T>::multiply(const T *x, T *y) const
+{
+  assert(finalized());
+
+  const size_t *const rowPtr = _rowPtr.data();
+  const size_t *const colIdx = _colIdx.data();
+  const T *const values = _values.data();
+
+  for (size_t i = 0; i < _rows; ++i)
+  {
+    T currentValue = T(0);
+    for (size_t k = rowPtr[i]; k < rowPtr[i + 1]; ++k)
+    {
+      currentValue += values[k] * x[colIdx[k]];
+    }
+    y[i] = currentValue;
+  }
+}
+
+template <typename T>
+std::vector<T> operator*(const SparseMatrix<T> &a,
+                         const std::vector<T> &b)
+{
+  if (a.cols() != b.size())
+  {
+    throw anpi::Exception("size of vector must be equal to the size of columns");
+  }
+
+  std::vector<T> result(a.rows());
+  a.multiply(b.data(), result.data());
+  return result;
+}
+
+} // namespace anpi
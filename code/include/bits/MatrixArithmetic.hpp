@@ -221,6 +221,66 @@ mm_add<int8_t>(__m512i a, __m512i b)
 {
   return _mm512_add_epi8(a, b);
 }
+template <>
+inline __m512d __attribute__((__always_inline__))
+mm_subs<double>(__m512d a, __m512d b)
+{
+  return _mm512_sub_pd(a, b);
+}
+template <>
+inline __m512 __attribute__((__always_inline__))
+mm_subs<float>(__m512 a, __m512 b)
+{
+  return _mm512_sub_ps(a, b);
+}
+template <>
+inline __m512i __attribute__((__always_inline__))
+mm_subs<uint64_t>(__m512i a, __m512i b)
+{
+  return _mm512_sub_epi64(a, b);
+}
+template <>
+inline __m512i __attribute__((__always_inline__))
+mm_subs<int64_t>(__m512i a, __m512i b)
+{
+  return _mm512_sub_epi64(a, b);
+}
+template <>
+inline __m512i __attribute__((__always_inline__))
+mm_subs<uint32_t>(__m512i a, __m512i b)
+{
+  return _mm512_sub_epi32(a, b);
+}
+template <>
+inline __m512i __attribute__((__always_inline__))
+mm_subs<int32_t>(__m512i a, __m512i b)
+{
+  return _mm512_sub_epi32(a, b);
+}
+template <>
+inline __m512i __attribute__((__always_inline__))
+mm_subs<uint16_t>(__m512i a, __m512i b)
+{
+  return _mm512_sub_epi16(a, b);
+}
+template <>
+inline __m512i __attribute__((__always_inline__))
+mm_subs<int16_t>(__m512i a, __m512i b)
+{
+  return _mm512_sub_epi16(a, b);
+}
+template <>
+inline __m512i __attribute__((__always_inline__))
+mm_subs<uint8_t>(__m512i a, __m512i b)
+{
+  return _mm512_sub_epi8(a, b);
+}
+template <>
+inline __m512i __attribute__((__always_inline__))
+mm_subs<int8_t>(__m512i a, __m512i b)
+{
+  return _mm512_sub_epi8(a, b);
+}
 #elif defined __AVX__
 template <>
 inline __m256d __attribute__((__always_inline__))
@@ -282,6 +342,66 @@ mm_add<int8_t>(__m256i a, __m256i b)
 {
   return _mm256_add_epi8(a, b);
 }
+template <>
+inline __m256d __attribute__((__always_inline__))
+mm_subs<double>(__m256d a, __m256d b)
+{
+  return _mm256_sub_pd(a, b);
+}
+template <>
+inline __m256 __attribute__((__always_inline__))
+mm_subs<float>(__m256 a, __m256 b)
+{
+  return _mm256_sub_ps(a, b);
+}
+template <>
+inline __m256i __attribute__((__always_inline__))
+mm_subs<uint64_t>(__m256i a, __m256i b)
+{
+  return _mm256_sub_epi64(a, b);
+}
+template <>
+inline __m256i __attribute__((__always_inline__))
+mm_subs<int64_t>(__m256i a, __m256i b)
+{
+  return _mm256_sub_epi64(a, b);
+}
+template <>
+inline __m256i __attribute__((__always_inline__))
+mm_subs<uint32_t>(__m256i a, __m256i b)
+{
+  return _mm256_sub_epi32(a, b);
+}
+template <>
+inline __m256i __attribute__((__always_inline__))
+mm_subs<int32_t>(__m256i a, __m256i b)
+{
+  return _mm256_sub_epi32(a, b);
+}
+template <>
+inline __m256i __attribute__((__always_inline__))
+mm_subs<uint16_t>(__m256i a, __m256i b)
+{
+  return _mm256_sub_epi16(a, b);
+}
+template <>
+inline __m256i __attribute__((__always_inline__))
+mm_subs<int16_t>(__m256i a, __m256i b)
+{
+  return _mm256_sub_epi16(a, b);
+}
+template <>
+inline __m256i __attribute__((__always_inline__))
+mm_subs<uint8_t>(__m256i a, __m256i b)
+{
+  return _mm256_sub_epi8(a, b);
+}
+template <>
+inline __m256i __attribute__((__always_inline__))
+mm_subs<int8_t>(__m256i a, __m256i b)
+{
+  return _mm256_sub_epi8(a, b);
+}
 #elif defined __SSE2__
 
 //Adittion
@@ -319,7 +439,7 @@ template <>
 inline __m128i __attribute__((__always_inline__))
 mm_add<std::int32_t>(__m128i a, __m128i b)
 {
-  return _mm_add_epi16(a, b);
+  return _mm_add_epi32(a, b);
 }
 template <>
 inline __m128i __attribute__((__always_inline__))
@@ -331,19 +451,19 @@ template <>
 inline __m128i __attribute__((__always_inline__))
 mm_add<std::int16_t>(__m128i a, __m128i b)
 {
-  return _mm_add_epi32(a, b);
+  return _mm_add_epi16(a, b);
 }
 template <>
 inline __m128i __attribute__((__always_inline__))
 mm_add<std::uint8_t>(__m128i a, __m128i b)
 {
-  return _mm_add_epi16(a, b);
+  return _mm_add_epi8(a, b);
 }
 template <>
 inline __m128i __attribute__((__always_inline__))
 mm_add<std::int8_t>(__m128i a, __m128i b)
 {
-  return _mm_add_epi32(a, b);
+  return _mm_add_epi8(a, b);
 }
 
 //Substraction
@@ -382,7 +502,7 @@ template <>
 inline __m128i __attribute__((__always_inline__))
 mm_subs<std::int32_t>(__m128i a, __m128i b)
 {
-  return _mm_sub_epi32(a, b); //_mm_sub_epi16(a, b);
+  return _mm_sub_epi32(a, b);
 }
 template <>
 inline __m128i __attribute__((__always_inline__))
@@ -394,23 +514,288 @@ template <>
 inline __m128i __attribute__((__always_inline__))
 mm_subs<std::int16_t>(__m128i a, __m128i b)
 {
-  return _mm_sub_epi16(a, b); //_mm_sub_epi32(a, b);
+  return _mm_sub_epi16(a, b);
 }
 template <>
 inline __m128i __attribute__((__always_inline__))
 mm_subs<std::uint8_t>(__m128i a, __m128i b)
 {
-  return _mm_sub_epi16(a, b);
+  return _mm_sub_epi8(a, b);
 }
 template <>
 inline __m128i __attribute__((__always_inline__))
 mm_subs<std::int8_t>(__m128i a, __m128i b)
 {
-  return _mm_sub_epi32(a, b);
+  return _mm_sub_epi8(a, b);
 }
 
 #endif
 
+/*
+ * Multiplication, broadcast and memory access, used by the matrix
+ * product.  Only the floating point types are wrapped.
+ */
+
+/// Element-wise product
+template <typename T, class regType>
+regType mm_mul(regType, regType);
+
+/// Register with all elements equal to a
+template <typename T, class regType>
+regType mm_set1(T a);
+
+/// Load from memory aligned to the register size
+template <typename T, class regType>
+regType mm_load(const T *p);
+
+/// Load from unaligned memory
+template <typename T, class regType>
+regType mm_loadu(const T *p);
+
+/// Store to unaligned memory
+template <typename T, class regType>
+void mm_storeu(T *p, regType a);
+
+/// Product plus addend a*b+c, fused in a single instruction if FMA is available
+template <typename T, class regType>
+regType mm_fmadd(regType a, regType b, regType c);
+
+#ifdef __AVX512F__
+template <>
+inline __m512d __attribute__((__always_inline__))
+mm_mul<double>(__m512d a, __m512d b)
+{
+  return _mm512_mul_pd(a, b);
+}
+template <>
+inline __m512d __attribute__((__always_inline__))
+mm_set1<double, __m512d>(double a)
+{
+  return _mm512_set1_pd(a);
+}
+template <>
+inline __m512d __attribute__((__always_inline__))
+mm_load<double, __m512d>(const double *p)
+{
+  return _mm512_load_pd(p);
+}
+template <>
+inline __m512d __attribute__((__always_inline__))
+mm_loadu<double, __m512d>(const double *p)
+{
+  return _mm512_loadu_pd(p);
+}
+template <>
+inline void __attribute__((__always_inline__))
+mm_storeu<double, __m512d>(double *p, __m512d a)
+{
+  _mm512_storeu_pd(p, a);
+}
+template <>
+inline __m512 __attribute__((__always_inline__))
+mm_mul<float>(__m512 a, __m512 b)
+{
+  return _mm512_mul_ps(a, b);
+}
+template <>
+inline __m512 __attribute__((__always_inline__))
+mm_set1<float, __m512>(float a)
+{
+  return _mm512_set1_ps(a);
+}
+template <>
+inline __m512 __attribute__((__always_inline__))
+mm_load<float, __m512>(const float *p)
+{
+  return _mm512_load_ps(p);
+}
+template <>
+inline __m512 __attribute__((__always_inline__))
+mm_loadu<float, __m512>(const float *p)
+{
+  return _mm512_loadu_ps(p);
+}
+template <>
+inline void __attribute__((__always_inline__))
+mm_storeu<float, __m512>(float *p, __m512 a)
+{
+  _mm512_storeu_ps(p, a);
+}
+template <>
+inline __m512d __attribute__((__always_inline__))
+mm_fmadd<double>(__m512d a, __m512d b, __m512d c)
+{
+  return _mm512_fmadd_pd(a, b, c);
+}
+template <>
+inline __m512 __attribute__((__always_inline__))
+mm_fmadd<float>(__m512 a, __m512 b, __m512 c)
+{
+  return _mm512_fmadd_ps(a, b, c);
+}
+#elif defined __AVX__
+template <>
+inline __m256d __attribute__((__always_inline__))
+mm_mul<double>(__m256d a, __m256d b)
+{
+  return _mm256_mul_pd(a, b);
+}
+template <>
+inline __m256d __attribute__((__always_inline__))
+mm_set1<double, __m256d>(double a)
+{
+  return _mm256_set1_pd(a);
+}
+template <>
+inline __m256d __attribute__((__always_inline__))
+mm_load<double, __m256d>(const double *p)
+{
+  return _mm256_load_pd(p);
+}
+template <>
+inline __m256d __attribute__((__always_inline__))
+mm_loadu<double, __m256d>(const double *p)
+{
+  return _mm256_loadu_pd(p);
+}
+template <>
+inline void __attribute__((__always_inline__))
+mm_storeu<double, __m256d>(double *p, __m256d a)
+{
+  _mm256_storeu_pd(p, a);
+}
+template <>
+inline __m256 __attribute__((__always_inline__))
+mm_mul<float>(__m256 a, __m256 b)
+{
+  return _mm256_mul_ps(a, b);
+}
+template <>
+inline __m256 __attribute__((__always_inline__))
+mm_set1<float, __m256>(float a)
+{
+  return _mm256_set1_ps(a);
+}
+template <>
+inline __m256 __attribute__((__always_inline__))
+mm_load<float, __m256>(const float *p)
+{
+  return _mm256_load_ps(p);
+}
+template <>
+inline __m256 __attribute__((__always_inline__))
+mm_loadu<float, __m256>(const float *p)
+{
+  return _mm256_loadu_ps(p);
+}
+template <>
+inline void __attribute__((__always_inline__))
+mm_storeu<float, __m256>(float *p, __m256 a)
+{
+  _mm256_storeu_ps(p, a);
+}
+#ifdef __FMA__
+template <>
+inline __m256d __attribute__((__always_inline__))
+mm_fmadd<double>(__m256d a, __m256d b, __m256d c)
+{
+  return _mm256_fmadd_pd(a, b, c);
+}
+template <>
+inline __m256 __attribute__((__always_inline__))
+mm_fmadd<float>(__m256 a, __m256 b, __m256 c)
+{
+  return _mm256_fmadd_ps(a, b, c);
+}
+#else
+template <>
+inline __m256d __attribute__((__always_inline__))
+mm_fmadd<double>(__m256d a, __m256d b, __m256d c)
+{
+  return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+}
+template <>
+inline __m256 __attribute__((__always_inline__))
+mm_fmadd<float>(__m256 a, __m256 b, __m256 c)
+{
+  return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+}
+#endif
+#elif defined __SSE2__
+template <>
+inline __m128d __attribute__((__always_inline__))
+mm_mul<double>(__m128d a, __m128d b)
+{
+  return _mm_mul_pd(a, b);
+}
+template <>
+inline __m128d __attribute__((__always_inline__))
+mm_set1<double, __m128d>(double a)
+{
+  return _mm_set1_pd(a);
+}
+template <>
+inline __m128d __attribute__((__always_inline__))
+mm_load<double, __m128d>(const double *p)
+{
+  return _mm_load_pd(p);
+}
+template <>
+inline __m128d __attribute__((__always_inline__))
+mm_loadu<double, __m128d>(const double *p)
+{
+  return _mm_loadu_pd(p);
+}
+template <>
+inline void __attribute__((__always_inline__))
+mm_storeu<double, __m128d>(double *p, __m128d a)
+{
+  _mm_storeu_pd(p, a);
+}
+template <>
+inline __m128 __attribute__((__always_inline__))
+mm_mul<float>(__m128 a, __m128 b)
+{
+  return _mm_mul_ps(a, b);
+}
+template <>
+inline __m128 __attribute__((__always_inline__))
+mm_set1<float, __m128>(float a)
+{
+  return _mm_set1_ps(a);
+}
+template <>
+inline __m128 __attribute__((__always_inline__))
+mm_load<float, __m128>(const float *p)
+{
+  return _mm_load_ps(p);
+}
+template <>
+inline __m128 __attribute__((__always_inline__))
+mm_loadu<float, __m128>(const float *p)
+{
+  return _mm_loadu_ps(p);
+}
+template <>
+inline void __attribute__((__always_inline__))
+mm_storeu<float, __m128>(float *p, __m128 a)
+{
+  _mm_storeu_ps(p, a);
+}
+template <>
+inline __m128d __attribute__((__always_inline__))
+mm_fmadd<double>(__m128d a, __m128d b, __m128d c)
+{
+  return _mm_add_pd(_mm_mul_pd(a, b), c);
+}
+template <>
+inline __m128 __attribute__((__always_inline__))
+mm_fmadd<float>(__m128 a, __m128 b, __m128 c)
+{
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+#endif
+
 // On-copy implementation c=a+b
 template <typename T, class Alloc, typename regType>
 inline void addSIMD(const Matrix<T, Alloc> &a,
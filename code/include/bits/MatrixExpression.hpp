@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#ifndef ANPI_MATRIX_EXPRESSION_HPP
+
+#define ANPI_MATRIX_EXPRESSION_HPP
+
+#include "MatrixArithmetic.hpp"
+#include <type_traits>
+
+namespace anpi
+{
+
+/*
+ * Lazy element-wise expressions
+ *
+ * The sum and difference of matrices do not compute anything: they
+ * return a small object describing the operation, which holds
+ * references to its operands.  Only when the expression is assigned to
+ * a matrix, all its operations are evaluated in a single loop over the
+ * destination, without temporary matrices.  An expression like
+ *
+ * \code
+ * c = a + b - d;
+ * \endcode
+ *
+ * reads each element of a, b and d once, and writes c once.
+ *
+ * All operands must have the same size and allocator, so that their
+ * elements, including the padding, are at the same positions of their
+ * memory blocks.  The expressions hold references to their operands, and
+ * hence must be evaluated before those are destroyed, as it happens when
+ * they are assigned in the same statement.
+ */
+
+/**
+   * Base class of all matrix expressions, with E the derived class.
+   *
+   * E has to provide value_type, allocator_type, rows(), cols(),
+   * dcols(), the element at a position of the memory block with at(i)
+   * and the register at that position with packet<regType>(i).
+   */
+template <class E>
+struct MatrixExpression
+{
+  /// The derived expression
+  inline const E &self() const { return static_cast<const E &>(*this); }
+};
+
+/**
+   * Leaf of an expression: reference to a matrix
+   */
+template <typename T, class Alloc>
+class MatrixTerm : public MatrixExpression<MatrixTerm<T, Alloc>>
+{
+public:
+  typedef T value_type;
+  typedef Alloc allocator_type;
+
+  explicit MatrixTerm(const Matrix<T, Alloc> &m) : _m(m) {}
+
+  inline size_t rows() const { return _m.rows(); }
+  inline size_t cols() const { return _m.cols(); }
+  inline size_t dcols() const { return _m.dcols(); }
+
+  /// Element at position i of the memory block
+  inline T at(const size_t i) const { return _m.data()[i]; }
+
+  /// Register at position i of the memory block, which must be aligned
+  template <typename regType>
+  inline regType packet(const size_t i) const
+  {
+    return *reinterpret_cast<const regType *>(_m.data() + i);
+  }
+
+private:
+  const Matrix<T, Alloc> &_m;
+};
+
+/// Sum of two elements or registers
+struct ExpressionPlus
+{
+  template <typename T>
+  static inline T apply(const T a, const T b) { return a + b; }
+
+  template <typename T, typename regType>
+  static inline regType packet(const regType a, const regType b)
+  {
+    return ::anpi::simd::mm_add<T>(a, b);
+  }
+};
+
+/// Difference of two elements or registers
+struct ExpressionMinus
+{
+  template <typename T>
+  static inline T apply(const T a, const T b) { return a - b; }
+
+  template <typename T, typename regType>
+  static inline regType packet(const regType a, const regType b)
+  {
+    return ::anpi::simd::mm_subs<T>(a, b);
+  }
+};
+
+/**
+   * Element-wise operation Op of two expressions
+   */
+template <class L, class R, class Op>
+class MatrixBinaryExpression
+    : public MatrixExpression<MatrixBinaryExpression<L, R, Op>>
+{
+public:
+  typedef typename L::value_type value_type;
+  typedef typename L::allocator_type allocator_type;
+
+  static_assert(std::is_same<value_type, typename R::value_type>::value,
+                "Operands of a matrix expression must have the same type");
+  static_assert(std::is_same<allocator_type, typename R::allocator_type>::value,
+                "Operands of a matrix expression must have the same allocator");
+
+  MatrixBinaryExpression(const L &l, const R &r) : _l(l), _r(r)
+  {
+    assert((l.rows() == r.rows()) && (l.cols() == r.cols()));
+  }
+
+  inline size_t rows() const { return _l.rows(); }
+  inline size_t cols() const { return _l.cols(); }
+  inline size_t dcols() const { return _l.dcols(); }
+
+  inline value_type at(const size_t i) const
+  {
+    return Op::apply(_l.at(i), _r.at(i));
+  }
+
+  template <typename regType>
+  inline regType packet(const size_t i) const
+  {
+    return Op::template packet<value_type>(_l.template packet<regType>(i),
+                                           _r.template packet<regType>(i));
+  }
+
+private:
+  /// Operands are held by value, since leaves only hold references
+  const L _l;
+  const R _r;
+};
+
+namespace bits
+{
+/// Type of the expression node representing operand X
+template <class X>
+struct expression_term
+{
+  typedef X type;
+};
+
+template <typename T, class Alloc>
+struct expression_term<Matrix<T, Alloc>>
+{
+  typedef MatrixTerm<T, Alloc> type;
+};
+
+/// Check if X can be used as operand of a matrix expression
+template <class X>
+struct is_expression_operand
+{
+  static constexpr bool value =
+      std::is_base_of<MatrixExpression<typename expression_term<X>::type>,
+                      typename expression_term<X>::type>::value;
+};
+
+/// Result of applying Op to operands L and R, if both are valid
+template <class L, class R, class Op>
+struct binary_expression
+    : std::enable_if<is_expression_operand<L>::value &&
+                         is_expression_operand<R>::value,
+                     MatrixBinaryExpression<typename expression_term<L>::type,
+                                            typename expression_term<R>::type,
+                                            Op>>
+{
+};
+} // namespace bits
+
+/// @name External arithmetic operators for matrices and expressions
+//@{
+template <class L, class R>
+inline typename bits::binary_expression<L, R, ExpressionPlus>::type
+operator+(const L &a, const R &b)
+{
+  typedef typename bits::binary_expression<L, R, ExpressionPlus>::type E;
+  return E(typename bits::expression_term<L>::type(a),
+           typename bits::expression_term<R>::type(b));
+}
+
+template <class L, class R>
+inline typename bits::binary_expression<L, R, ExpressionMinus>::type
+operator-(const L &a, const R &b)
+{
+  typedef typename bits::binary_expression<L, R, ExpressionMinus>::type E;
+  return E(typename bits::expression_term<L>::type(a),
+           typename bits::expression_term<R>::type(b));
+}
+//@}
+
+namespace fallback
+{
+// Evaluate the expression e into c, which must have its size
+template <typename T, class Alloc, class E>
+inline void assign(Matrix<T, Alloc> &c,
+                   const MatrixExpression<E> &e)
+{
+
+  const E &expr = e.self();
+  const size_t tentries = c.rows() * c.dcols();
+
+  T *here = c.data();
+  for (size_t i = 0; i < tentries; ++i)
+  {
+    here[i] = expr.at(i);
+  }
+}
+} // namespace fallback
+
+namespace simd
+{
+// Evaluate the expression e into c with registers of type regType
+template <typename T, class Alloc, class E, typename regType>
+inline void assignSIMD(Matrix<T, Alloc> &c,
+                       const MatrixExpression<E> &e)
+{
+
+  static_assert(!extract_alignment<Alloc>::aligned ||
+                    (extract_alignment<Alloc>::value >= sizeof(regType)),
+                "Insufficient alignment for the registers used");
+
+  const E &expr = e.self();
+  const size_t lanes = sizeof(regType) / sizeof(T);
+  const size_t tentries = c.rows() * c.dcols();
+
+  regType *here = reinterpret_cast<regType *>(c.data());
+  const size_t blocks = (tentries + (lanes - 1)) / lanes;
+  for (size_t b = 0; b < blocks; ++b)
+  {
+    here[b] = expr.template packet<regType>(b * lanes);
+  }
+}
+
+// Evaluate the expression e into c for SIMD-capable types
+template <typename T,
+          class Alloc,
+          class E,
+          typename std::enable_if<is_simd_type<T>::value, int>::type = 0>
+inline void assign(Matrix<T, Alloc> &c,
+                   const MatrixExpression<E> &e)
+{
+
+  if (is_aligned_alloc<Alloc>::value)
+  {
+#ifdef __AVX512F__
+    assignSIMD<T, Alloc, E, typename avx512_traits<T>::reg_type>(c, e);
+#elif __AVX__
+    assignSIMD<T, Alloc, E, typename avx_traits<T>::reg_type>(c, e);
+#elif __SSE2__
+    assignSIMD<T, Alloc, E, typename sse2_traits<T>::reg_type>(c, e);
+#else
+    ::anpi::fallback::assign(c, e);
+#endif
+  }
+  else
+  { // allocator seems to be unaligned
+    ::anpi::fallback::assign(c, e);
+  }
+}
+
+// Non-SIMD types such as complex
+template <typename T,
+          class Alloc,
+          class E,
+          typename std::enable_if<!is_simd_type<T>::value, int>::type = 0>
+inline void assign(Matrix<T, Alloc> &c,
+                   const MatrixExpression<E> &e)
+{
+
+  ::anpi::fallback::assign(c, e);
+}
+} // namespace simd
+
+} // namespace anpi
+
+#endif
@@ -0,0 +1,643 @@
+/*
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, ITCR, Costa Rica
+ *
+ * This file is part of the numerical analysis lecture CE3102 at TEC
+ */
+
+#ifndef ANPI_MATRIX_PRODUCT_HPP
+
+#define ANPI_MATRIX_PRODUCT_HPP
+
+#include "MatrixArithmetic.hpp"
+#include <algorithm>
+#include <vector>
+#include <type_traits>
+
+namespace anpi
+{
+namespace fallback
+{
+/*
+     * Product
+     */
+
+// Implementation of c = alpha*a*b + beta*c on views.  c must not
+// overlap a or b.
+template <typename T>
+inline void multiplyAdd(const T alpha,
+                        const MatrixView<const T> &a,
+                        const MatrixView<const T> &b,
+                        const T beta,
+                        const MatrixView<T> &c)
+{
+
+  assert(a.cols() == b.rows());
+  assert((c.rows() == a.rows()) && (c.cols() == b.cols()));
+
+  const size_t rows = c.rows();
+  const size_t cols = c.cols();
+  const size_t depth = a.cols();
+  const size_t ccs = c.colStride();
+  const size_t acs = a.colStride();
+  const size_t bcs = b.colStride();
+
+  // Row i of c accumulates the rows of b weighted with the elements of
+  // row i of a, so that all loops traverse rows.  Each element still
+  // adds its products in the order of k.
+  for (size_t i = 0; i < rows; ++i)
+  {
+    T *ci = c.data() + i * c.rowStride();
+    for (size_t j = 0; j < cols; ++j)
+    {
+      // with beta zero c may hold anything, even NaN
+      ci[j * ccs] = (beta == T(0)) ? T(0) : beta * ci[j * ccs];
+    }
+
+    const T *ai = a.data() + i * a.rowStride();
+    for (size_t k = 0; k < depth; ++k)
+    {
+      const T aik = alpha * ai[k * acs];
+      const T *bk = b.data() + k * b.rowStride();
+      for (size_t j = 0; j < cols; ++j)
+      {
+        ci[j * ccs] += aik * bk[j * bcs];
+      }
+    }
+  }
+}
+
+// In-copy implementation c=a*b
+template <typename T, class Alloc>
+inline void multiply(const Matrix<T, Alloc> &a,
+                     const Matrix<T, Alloc> &b,
+                     Matrix<T, Alloc> &c)
+{
+
+  assert((&c != &a) && (&c != &b));
+
+  c.allocate(a.rows(), b.cols());
+  ::anpi::fallback::multiplyAdd(T(1), a.view(), b.view(), T(0), c.view());
+}
+
+// Implementation of y = alpha*a*x + beta*y on a view
+template <typename T>
+inline void multiplyAdd(const T alpha,
+                        const MatrixView<const T> &a,
+                        const std::vector<T> &x,
+                        const T beta,
+                        std::vector<T> &y)
+{
+
+  assert((a.cols() == x.size()) && (a.rows() == y.size()));
+
+  const size_t rows = a.rows();
+  const size_t cols = a.cols();
+  const size_t acs = a.colStride();
+
+  for (size_t i = 0; i < rows; ++i)
+  {
+    const T *ai = a.data() + i * a.rowStride();
+    T sum = T(0);
+    for (size_t j = 0; j < cols; ++j)
+    {
+      sum += ai[j * acs] * x[j];
+    }
+    // with beta zero y may hold anything, even NaN
+    y[i] = (beta == T(0)) ? alpha * sum : alpha * sum + beta * y[i];
+  }
+}
+
+// Implementation of y = alpha*a*x + beta*y
+template <typename T, class Alloc>
+inline void multiplyAdd(const T alpha,
+                        const Matrix<T, Alloc> &a,
+                        const std::vector<T> &x,
+                        const T beta,
+                        std::vector<T> &y)
+{
+
+  ::anpi::fallback::multiplyAdd(alpha, a.view(), x, beta, y);
+}
+
+// In-copy implementation y=a*x
+template <typename T, class Alloc>
+inline void multiply(const Matrix<T, Alloc> &a,
+                     const std::vector<T> &x,
+                     std::vector<T> &y)
+{
+
+  assert(&x != &y);
+
+  y.resize(a.rows());
+  ::anpi::fallback::multiplyAdd(T(1), a.view(), x, T(0), y);
+}
+
+} // namespace fallback
+
+namespace simd
+{
+/*
+     * Product
+     *
+     * The product is computed as in the GotoBLAS scheme: c is split in
+     * panels of nc columns, the depth in slices of kc, and for each
+     * slice a kc x nc panel of b is packed in slivers of nr columns,
+     * which are shared by all blocks of mc rows of a.  Each block of a
+     * is packed in slivers of mr rows, and a micro-kernel computes an
+     * mr x nr tile of c holding it in registers while both slivers are
+     * traversed.  The sizes are chosen so that a sliver of b stays in
+     * L1, a block of a in L2 and a panel of b in L3.
+     */
+
+/// Rows of the tile of c computed by gemmKernel()
+static const size_t GemmRows = 4;
+
+/**
+     * Compute the GemmRows x (2 registers) tile of c at the given
+     * position, adding the products of the packed slivers of a and b
+     * to its current content.  ldc is the distance between rows of c.
+     * The products are fused with the additions if FMA is available.
+     */
+template <typename T, typename regType>
+inline void gemmKernel(const size_t kc,
+                       const T *pa,
+                       const T *pb,
+                       T *c,
+                       const size_t ldc)
+{
+
+  const size_t lanes = sizeof(regType) / sizeof(T);
+
+  T *const c0 = c;
+  T *const c1 = c0 + ldc;
+  T *const c2 = c1 + ldc;
+  T *const c3 = c2 + ldc;
+
+  regType c00 = mm_loadu<T, regType>(c0), c01 = mm_loadu<T, regType>(c0 + lanes);
+  regType c10 = mm_loadu<T, regType>(c1), c11 = mm_loadu<T, regType>(c1 + lanes);
+  regType c20 = mm_loadu<T, regType>(c2), c21 = mm_loadu<T, regType>(c2 + lanes);
+  regType c30 = mm_loadu<T, regType>(c3), c31 = mm_loadu<T, regType>(c3 + lanes);
+
+  for (size_t k = 0; k < kc; ++k, pa += GemmRows, pb += 2 * lanes)
+  {
+    const regType b0 = mm_load<T, regType>(pb);
+    const regType b1 = mm_load<T, regType>(pb + lanes);
+
+    regType a = mm_set1<T, regType>(pa[0]);
+    c00 = mm_fmadd<T>(a, b0, c00);
+    c01 = mm_fmadd<T>(a, b1, c01);
+
+    a = mm_set1<T, regType>(pa[1]);
+    c10 = mm_fmadd<T>(a, b0, c10);
+    c11 = mm_fmadd<T>(a, b1, c11);
+
+    a = mm_set1<T, regType>(pa[2]);
+    c20 = mm_fmadd<T>(a, b0, c20);
+    c21 = mm_fmadd<T>(a, b1, c21);
+
+    a = mm_set1<T, regType>(pa[3]);
+    c30 = mm_fmadd<T>(a, b0, c30);
+    c31 = mm_fmadd<T>(a, b1, c31);
+  }
+
+  mm_storeu<T, regType>(c0, c00);
+  mm_storeu<T, regType>(c0 + lanes, c01);
+  mm_storeu<T, regType>(c1, c10);
+  mm_storeu<T, regType>(c1 + lanes, c11);
+  mm_storeu<T, regType>(c2, c20);
+  mm_storeu<T, regType>(c2 + lanes, c21);
+  mm_storeu<T, regType>(c3, c30);
+  mm_storeu<T, regType>(c3 + lanes, c31);
+}
+
+/**
+     * Pack the block of a with rows [i0,i0+mb) and columns [k0,k0+kb),
+     * scaled by alpha, in slivers of GemmRows rows, stored column after
+     * column.  The last sliver is padded with zeros.
+     */
+template <typename T>
+inline void gemmPackA(const MatrixView<const T> &a,
+                      const T alpha,
+                      const size_t i0,
+                      const size_t mb,
+                      const size_t k0,
+                      const size_t kb,
+                      T *pa)
+{
+
+  const size_t cs = a.colStride();
+  for (size_t s = 0; s < mb; s += GemmRows)
+  {
+    const T *rows[GemmRows];
+    for (size_t r = 0; r < GemmRows; ++r)
+    {
+      rows[r] = (s + r < mb) ? a.data() + (i0 + s + r) * a.rowStride() + k0 * cs
+                             : nullptr;
+    }
+
+    for (size_t k = 0; k < kb; ++k)
+    {
+      for (size_t r = 0; r < GemmRows; ++r)
+      {
+        *pa++ = (rows[r] != nullptr) ? alpha * rows[r][k * cs] : T(0);
+      }
+    }
+  }
+}
+
+/**
+     * Pack the panel of b with rows [k0,k0+kb) and columns [j0,j0+nb)
+     * in slivers of nr columns, stored row after row.  The last sliver
+     * is padded with zeros.
+     */
+template <typename T>
+inline void gemmPackB(const MatrixView<const T> &b,
+                      const size_t k0,
+                      const size_t kb,
+                      const size_t j0,
+                      const size_t nb,
+                      const size_t nr,
+                      T *pb)
+{
+
+  const size_t cs = b.colStride();
+  for (size_t s = 0; s < nb; s += nr)
+  {
+    const size_t w = std::min(nr, nb - s);
+    for (size_t k = 0; k < kb; ++k)
+    {
+      const T *bk = b.data() + (k0 + k) * b.rowStride() + (j0 + s) * cs;
+      size_t c = 0;
+      for (; c < w; ++c)
+      {
+        *pb++ = bk[c * cs];
+      }
+      for (; c < nr; ++c)
+      {
+        *pb++ = T(0);
+      }
+    }
+  }
+}
+
+// Implementation of c = alpha*a*b + beta*c with registers of type regType
+template <typename T, typename regType>
+inline void gemmSIMD(const T alpha,
+                     const MatrixView<const T> &a,
+                     const MatrixView<const T> &b,
+                     const T beta,
+                     const MatrixView<T> &c)
+{
+
+  typedef std::vector<T, anpi::aligned_allocator<T>> buffer;
+
+  const size_t lanes = sizeof(regType) / sizeof(T);
+  const size_t mr = GemmRows;
+  const size_t nr = 2 * lanes;
+
+  // a kc x nr sliver of b takes 16 KiB (L1), a mc x kc block of a
+  // 128 KiB (L2), and a kc x nc panel of b 2 MiB (L3)
+  const size_t kc = (16 * 1024) / (nr * sizeof(T));
+  const size_t mc = ((128 * 1024) / (kc * sizeof(T))) / mr * mr;
+  const size_t nc = ((2048 * 1024) / (kc * sizeof(T))) / nr * nr;
+
+  const size_t rows = c.rows();
+  const size_t cols = c.cols();
+  const size_t depth = a.cols();
+
+  // Matrices smaller than a single tile are not worth the packing
+  if ((rows < mr) || (cols < nr))
+  {
+    ::anpi::fallback::multiplyAdd(alpha, a, b, beta, c);
+    return;
+  }
+
+  // the tiles are accumulated on c
+  if (beta == T(0))
+  {
+    c.fill(T(0));
+  }
+  else if (beta != T(1))
+  {
+    for (size_t i = 0; i < rows; ++i)
+    {
+      for (size_t j = 0; j < cols; ++j)
+      {
+        c(i, j) *= beta;
+      }
+    }
+  }
+
+  const size_t rs = c.rowStride();
+  const size_t cs = c.colStride();
+
+  // packing buffers, no larger than the matrices themselves.  They are
+  // kept by each thread, so that repeated products, like the updates of
+  // the blocked LU decomposition, do not allocate memory.
+  const size_t kmax = std::min(kc, depth);
+  const size_t mmax = std::min(mc, (rows + mr - 1) / mr * mr);
+  static thread_local buffer pbuf;
+  pbuf.resize(std::max(pbuf.size(), kmax * std::min(nc, (cols + nr - 1) / nr * nr)));
+  T *const pb = pbuf.data();
+  const long mblocks = long((rows + mc - 1) / mc);
+
+  for (size_t jc = 0; jc < cols; jc += nc)
+  {
+    const size_t nb = std::min(nc, cols - jc);
+
+    for (size_t pc = 0; pc < depth; pc += kc)
+    {
+      const size_t kb = std::min(kc, depth - pc);
+      gemmPackB(b, pc, kb, jc, nb, nr, pb);
+
+      // the blocks of rows of c are independent
+#ifdef _OPENMP
+#pragma omp parallel if (mblocks > 1)
+#endif
+      {
+        static thread_local buffer pabuf;
+        pabuf.resize(std::max(pabuf.size(), mmax * kb));
+        T *const pa = pabuf.data();
+        T tile[GemmRows * 2 * (sizeof(regType) / sizeof(T))];
+
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (long ib = 0; ib < mblocks; ++ib)
+        {
+          const size_t ic = size_t(ib) * mc;
+          const size_t mb = std::min(mc, rows - ic);
+          gemmPackA(a, alpha, ic, mb, pc, kb, pa);
+
+          for (size_t jr = 0; jr < nb; jr += nr)
+          {
+            const size_t w = std::min(nr, nb - jr);
+            const T *psb = pb + jr * kb;
+
+            for (size_t ir = 0; ir < mb; ir += mr)
+            {
+              const size_t h = std::min(mr, mb - ir);
+              const T *psa = pa + ir * kb;
+              T *cij = c.data() + (ic + ir) * rs + (jc + jr) * cs;
+
+              if ((h == mr) && (w == nr) && (cs == 1))
+              {
+                gemmKernel<T, regType>(kb, psa, psb, cij, rs);
+              }
+              else
+              { // border or strided tile, computed on a copy
+                for (size_t r = 0; r < mr; ++r)
+                {
+                  for (size_t s = 0; s < nr; ++s)
+                  {
+                    tile[r * nr + s] = ((r < h) && (s < w)) ? cij[r * rs + s * cs] : T(0);
+                  }
+                }
+
+                gemmKernel<T, regType>(kb, psa, psb, tile, nr);
+
+                for (size_t r = 0; r < h; ++r)
+                {
+                  for (size_t s = 0; s < w; ++s)
+                  {
+                    cij[r * rs + s * cs] = tile[r * nr + s];
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// Implementation of c = alpha*a*b + beta*c on views for floating
+// point types.  c must not overlap a or b.
+template <typename T,
+          typename std::enable_if<is_simd_type<T>::value &&
+                                      std::is_floating_point<T>::value,
+                                  int>::type = 0>
+inline void multiplyAdd(const T alpha,
+                        const MatrixView<const T> &a,
+                        const MatrixView<const T> &b,
+                        const T beta,
+                        const MatrixView<T> &c)
+{
+
+  assert(a.cols() == b.rows());
+  assert((c.rows() == a.rows()) && (c.cols() == b.cols()));
+
+#ifdef __AVX512F__
+  gemmSIMD<T, typename avx512_traits<T>::reg_type>(alpha, a, b, beta, c);
+#elif __AVX__
+  gemmSIMD<T, typename avx_traits<T>::reg_type>(alpha, a, b, beta, c);
+#elif __SSE2__
+  gemmSIMD<T, typename sse2_traits<T>::reg_type>(alpha, a, b, beta, c);
+#else
+  ::anpi::fallback::multiplyAdd(alpha, a, b, beta, c);
+#endif
+}
+
+// Integer and non-SIMD types such as complex
+template <typename T,
+          typename std::enable_if<!(is_simd_type<T>::value &&
+                                    std::is_floating_point<T>::value),
+                                  int>::type = 0>
+inline void multiplyAdd(const T alpha,
+                        const MatrixView<const T> &a,
+                        const MatrixView<const T> &b,
+                        const T beta,
+                        const MatrixView<T> &c)
+{
+
+  ::anpi::fallback::multiplyAdd(alpha, a, b, beta, c);
+}
+
+// In-copy implementation c=a*b
+template <typename T, class Alloc>
+inline void multiply(const Matrix<T, Alloc> &a,
+                     const Matrix<T, Alloc> &b,
+                     Matrix<T, Alloc> &c)
+{
+
+  assert((&c != &a) && (&c != &b));
+
+  c.allocate(a.rows(), b.cols());
+  ::anpi::simd::multiplyAdd(T(1), a.view(), b.view(), T(0), c.view());
+}
+
+/*
+     * Product with a vector
+     */
+
+/// Sum of all elements of the register
+template <typename T, typename regType>
+inline T mm_hsum(regType a)
+{
+
+  const size_t lanes = sizeof(regType) / sizeof(T);
+  T v[lanes];
+  mm_storeu<T, regType>(v, a);
+
+  T sum = T(0);
+  for (size_t l = 0; l < lanes; ++l)
+  {
+    sum += v[l];
+  }
+  return sum;
+}
+
+// Implementation of y = alpha*a*x + beta*y with registers of type
+// regType, for views with contiguous rows
+template <typename T, typename regType>
+inline void gemvSIMD(const T alpha,
+                     const MatrixView<const T> &a,
+                     const std::vector<T> &x,
+                     const T beta,
+                     std::vector<T> &y)
+{
+
+  const size_t lanes = sizeof(regType) / sizeof(T);
+  const size_t rows = a.rows();
+  const size_t cols = a.cols();
+
+  // columns processed with full registers; the rest is the tail
+  const size_t body = cols / lanes * lanes;
+  const T *const xp = x.data();
+
+  auto store = [&](const size_t i, const T sum) {
+    y[i] = (beta == T(0)) ? alpha * sum : alpha * sum + beta * y[i];
+  };
+
+  // four rows at a time share each load of x
+  size_t i = 0;
+  for (; i + 4 <= rows; i += 4)
+  {
+    const T *const a0 = a[i];
+    const T *const a1 = a[i + 1];
+    const T *const a2 = a[i + 2];
+    const T *const a3 = a[i + 3];
+
+    regType s0 = mm_set1<T, regType>(T(0));
+    regType s1 = s0, s2 = s0, s3 = s0;
+    for (size_t j = 0; j < body; j += lanes)
+    {
+      const regType xj = mm_loadu<T, regType>(xp + j);
+      s0 = mm_fmadd<T>(mm_loadu<T, regType>(a0 + j), xj, s0);
+      s1 = mm_fmadd<T>(mm_loadu<T, regType>(a1 + j), xj, s1);
+      s2 = mm_fmadd<T>(mm_loadu<T, regType>(a2 + j), xj, s2);
+      s3 = mm_fmadd<T>(mm_loadu<T, regType>(a3 + j), xj, s3);
+    }
+
+    T d0 = mm_hsum<T>(s0), d1 = mm_hsum<T>(s1);
+    T d2 = mm_hsum<T>(s2), d3 = mm_hsum<T>(s3);
+    for (size_t j = body; j < cols; ++j)
+    {
+      d0 += a0[j] * xp[j];
+      d1 += a1[j] * xp[j];
+      d2 += a2[j] * xp[j];
+      d3 += a3[j] * xp[j];
+    }
+
+    store(i, d0);
+    store(i + 1, d1);
+    store(i + 2, d2);
+    store(i + 3, d3);
+  }
+
+  for (; i < rows; ++i)
+  {
+    const T *const ai = a[i];
+    regType s = mm_set1<T, regType>(T(0));
+    for (size_t j = 0; j < body; j += lanes)
+    {
+      s = mm_fmadd<T>(mm_loadu<T, regType>(ai + j), mm_loadu<T, regType>(xp + j), s);
+    }
+
+    T d = mm_hsum<T>(s);
+    for (size_t j = body; j < cols; ++j)
+    {
+      d += ai[j] * xp[j];
+    }
+    store(i, d);
+  }
+}
+
+// Implementation of y = alpha*a*x + beta*y on a view for floating
+// point types
+template <typename T,
+          typename std::enable_if<is_simd_type<T>::value &&
+                                      std::is_floating_point<T>::value,
+                                  int>::type = 0>
+inline void multiplyAdd(const T alpha,
+                        const MatrixView<const T> &a,
+                        const std::vector<T> &x,
+                        const T beta,
+                        std::vector<T> &y)
+{
+
+  assert((a.cols() == x.size()) && (a.rows() == y.size()));
+
+  if (!a.contiguousRows())
+  { // e.g. transposed views
+    ::anpi::fallback::multiplyAdd(alpha, a, x, beta, y);
+    return;
+  }
+
+#ifdef __AVX512F__
+  gemvSIMD<T, typename avx512_traits<T>::reg_type>(alpha, a, x, beta, y);
+#elif __AVX__
+  gemvSIMD<T, typename avx_traits<T>::reg_type>(alpha, a, x, beta, y);
+#elif __SSE2__
+  gemvSIMD<T, typename sse2_traits<T>::reg_type>(alpha, a, x, beta, y);
+#else
+  ::anpi::fallback::multiplyAdd(alpha, a, x, beta, y);
+#endif
+}
+
+// Integer and non-SIMD types such as complex
+template <typename T,
+          typename std::enable_if<!(is_simd_type<T>::value &&
+                                    std::is_floating_point<T>::value),
+                                  int>::type = 0>
+inline void multiplyAdd(const T alpha,
+                        const MatrixView<const T> &a,
+                        const std::vector<T> &x,
+                        const T beta,
+                        std::vector<T> &y)
+{
+
+  ::anpi::fallback::multiplyAdd(alpha, a, x, beta, y);
+}
+
+// Implementation of y = alpha*a*x + beta*y
+template <typename T, class Alloc>
+inline void multiplyAdd(const T alpha,
+                        const Matrix<T, Alloc> &a,
+                        const std::vector<T> &x,
+                        const T beta,
+                        std::vector<T> &y)
+{
+
+  ::anpi::simd::multiplyAdd(alpha, a.view(), x, beta, y);
+}
+
+// In-copy implementation y=a*x
+template <typename T, class Alloc>
+inline void multiply(const Matrix<T, Alloc> &a,
+                     const std::vector<T> &x,
+                     std::vector<T> &y)
+{
+
+  assert(&x != &y);
+
+  y.resize(a.rows());
+  ::anpi::simd::multiplyAdd(T(1), a.view(), x, T(0), y);
+}
+
+} // namespace simd
+} // namespace anpi
+
+#endif
@@ -1,8 +1,197 @@
 #include "ResistorGrid.hpp"
 #include "Solver.hpp"
+#include "SparseLU.hpp"
+#include "ConjugateGradient.hpp"
+#include "Multigrid.hpp"
+#include "SparseCholesky.hpp"
+#include "Intrinsics.hpp"
+#include "Parallel.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
 namespace anpi
 {
 
+namespace
+{
+/// Version of the cached data, to be changed with its layout
+const std::uint64_t CacheVersion = 1;
+
+/// FNV-1a hash of a block of bytes, continuing from hash h
+std::uint64_t hashBytes(const void *data, const size_t bytes, std::uint64_t h)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/// Hash of a value, continuing from hash h
+template <typename T>
+inline std::uint64_t hashValue(const T &value, const std::uint64_t h)
+{
+    return hashBytes(&value, sizeof(T), h);
+}
+
+/**
+ * Resistance of the n pixels, looked up in the table of the resistance
+ * model.  With AVX2 eight pixels are converted to levels and gathered
+ * from the table at once.
+ */
+void pixelResistances(const float *pixels, const float *table, float *r, const size_t n)
+{
+    size_t j = 0;
+#if defined(__AVX2__)
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(float(ResistanceModel::Levels - 1));
+    const __m256 half = _mm256_set1_ps(0.5f);
+    for (; j + 8 <= n; j += 8)
+    {
+        const __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(pixels + j), zero), one);
+        const __m256i idx = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, scale), half));
+        _mm256_storeu_ps(r + j, _mm256_i32gather_ps(table, idx, 4));
+    }
+#endif
+    for (; j < n; ++j)
+    {
+        r[j] = table[ResistanceModel::level(pixels[j])];
+    }
+}
+
+/**
+ * Resistance of the n resistors between the pixels with resistances
+ * a[j] and b[j], the larger of both, computed in SIMD registers
+ */
+void resistanceRow(const float *a, const float *b, float *r, const size_t n)
+{
+    size_t j = 0;
+#if defined(__AVX__)
+    for (; j + 8 <= n; j += 8)
+    {
+        _mm256_storeu_ps(r + j, _mm256_max_ps(_mm256_loadu_ps(a + j),
+                                              _mm256_loadu_ps(b + j)));
+    }
+#elif defined(__SSE2__)
+    for (; j + 4 <= n; j += 4)
+    {
+        _mm_storeu_ps(r + j, _mm_max_ps(_mm_loadu_ps(a + j),
+                                        _mm_loadu_ps(b + j)));
+    }
+#endif
+    for (; j < n; ++j)
+    {
+        r[j] = std::max(a[j], b[j]);
+    }
+}
+
+/**
+ * Mean of the n currents a[j] and b[j], stored in single precision.
+ * With AVX four pairs are averaged and converted at once.
+ */
+void meanCurrentRow(const double *a, const double *b, float *r, const size_t n)
+{
+    size_t j = 0;
+#if defined(__AVX__)
+    const __m256d half = _mm256_set1_pd(0.5);
+    for (; j + 4 <= n; j += 4)
+    {
+        const __m256d sum = _mm256_add_pd(_mm256_loadu_pd(a + j), _mm256_loadu_pd(b + j));
+        _mm_storeu_ps(r + j, _mm256_cvtpd_ps(_mm256_mul_pd(sum, half)));
+    }
+#elif defined(__SSE2__)
+    const __m128d half = _mm_set1_pd(0.5);
+    for (; j + 2 <= n; j += 2)
+    {
+        const __m128d sum = _mm_add_pd(_mm_loadu_pd(a + j), _mm_loadu_pd(b + j));
+        _mm_storel_pi(reinterpret_cast<__m64 *>(r + j), _mm_cvtpd_ps(_mm_mul_pd(sum, half)));
+    }
+#endif
+    for (; j < n; ++j)
+    {
+        r[j] = float(0.5 * (a[j] + b[j]));
+    }
+}
+
+/**
+ * Direction of the current field at any point of the grid, interpolated
+ * bilinearly between the four surrounding nodes and normalized.  Points
+ * outside the grid take the field of the nearest border.
+ */
+class FieldDirection
+{
+  public:
+    FieldDirection(const Matrix<float> &dx, const Matrix<float> &dy)
+        : dx(dx), dy(dy), lastRow(double(dx.rows() - 1)), lastCol(double(dx.cols() - 1)) {}
+
+    /// @return false if the field vanishes at p
+    bool operator()(const PathPoint &p, PathPoint &d) const
+    {
+        const double r = std::min(std::max(p.row, 0.0), lastRow);
+        const double c = std::min(std::max(p.col, 0.0), lastCol);
+        const size_t i0 = size_t(r), j0 = size_t(c);
+        const size_t i1 = std::min(i0 + 1, dx.rows() - 1), j1 = std::min(j0 + 1, dx.cols() - 1);
+        const double fr = r - double(i0), fc = c - double(j0);
+
+        const double w00 = (1.0 - fr) * (1.0 - fc), w01 = (1.0 - fr) * fc;
+        const double w10 = fr * (1.0 - fc), w11 = fr * fc;
+
+        d.col = w00 * dx[i0][j0] + w01 * dx[i0][j1] + w10 * dx[i1][j0] + w11 * dx[i1][j1];
+        d.row = w00 * dy[i0][j0] + w01 * dy[i0][j1] + w10 * dy[i1][j0] + w11 * dy[i1][j1];
+
+        const double norm = std::sqrt(d.row * d.row + d.col * d.col);
+        if (!(norm > 0.0))
+            return false;
+        d.row /= norm;
+        d.col /= norm;
+        return true;
+    }
+
+  private:
+    const Matrix<float> &dx;
+    const Matrix<float> &dy;
+    const double lastRow;
+    const double lastCol;
+};
+
+/// Classic Runge-Kutta step of length h along the field, from p to q
+bool rk4Step(const FieldDirection &field, const PathPoint &p, const double h, PathPoint &q)
+{
+    PathPoint k1, k2, k3, k4;
+    if (!field(p, k1) ||
+        !field({p.row + 0.5 * h * k1.row, p.col + 0.5 * h * k1.col}, k2) ||
+        !field({p.row + 0.5 * h * k2.row, p.col + 0.5 * h * k2.col}, k3) ||
+        !field({p.row + h * k3.row, p.col + h * k3.col}, k4))
+    {
+        return false;
+    }
+
+    q.row = p.row + h / 6.0 * (k1.row + 2.0 * k2.row + 2.0 * k3.row + k4.row);
+    q.col = p.col + h / 6.0 * (k1.col + 2.0 * k2.col + 2.0 * k3.col + k4.col);
+    return true;
+}
+
+/// The n currents a[j] in single precision
+void currentRow(const double *a, float *r, const size_t n)
+{
+    for (size_t j = 0; j < n; ++j)
+    {
+        r[j] = float(a[j]);
+    }
+}
+} // namespace
+
+const std::size_t ResistorGrid::BatchBlock;
+
 ///... constructors  and  other  methods
 
 /**
@@ -29,6 +218,9 @@ bool ResistorGrid::build(const std::string filename)
         // And transform it to a SIMD-enabled matrix
         anpi::Matrix<float> amap(amapTmp);
         rawMap = amap;
+        computeIndexTables();
+        computeResistances();
+        nodalReady = false;
 
         return true;
     }
@@ -42,6 +234,18 @@ bool ResistorGrid::build(const std::string filename)
 ∗ Compute the internal data to navigate between the given nodes
 */
 bool ResistorGrid::navigate(const indexPair &nodes)
+{
+    prepare();
+    return navigate(nodes, state);
+}
+
+/**
+ * Only the context is written, so that several threads can navigate at
+ * the same time with their own contexts.  The mesh system depends on
+ * the start and end nodes and is assembled in the context; the nodal
+ * system must have been prepared.
+ */
+bool ResistorGrid::navigate(const indexPair &nodes, NavigationContext &context) const
 {
     int cols = rawMap.cols(), rows = rawMap.rows();
     if (cols == 0 || rows == 0)
@@ -65,409 +269,140 @@ bool ResistorGrid::navigate(const indexPair &nodes)
         throw anpi::Exception("Start and End nodes are the same, no path to navigate\n");
         return false;
     }
-    //initialize A & b
-    ResistorGrid::A.allocate(resistors, resistors);
-    ResistorGrid::A.fill(0.f);
-    std::vector<double> btemp(resistors, 0);
-    ResistorGrid::b = btemp;
-
-    //************************************************* node equations ************************************************************************************
-    int nodePtr;
-    //if one of the start or finish nodes is the first node 0,0 we can't eliminate that one
-    if ((startNode == 0) || (endNode == 0))
-    {
-
-        //if one of the start or finish nodes is the last node n,m we can't eliminate that one
-        if ((startNode == nodeEquationNum) || (endNode == nodeEquationNum))
-        {
-            //so we eliminate node 0,1
-
-            //assign b values
-            //since we are removing the second equation the indexes of the start and end nodes change depending if
-            //one of them is the first node
-            if (startNode == 0)
-            {
-                b[startNode] = 1;
-                b[endNode - 1] = -1;
-            }
-            else if (endNode == 0)
-            {
-                b[startNode - 1] = 1;
-                b[endNode] = -1;
-            }
-            else
-            {
-                b[startNode - 1] = 1;
-                b[endNode - 1] = -1;
-            }
-
-            nodePtr = 0;
 
-            for (int i = 0; i < nodeEquationNum - 1; ++i)
-            {
-                // because we are skipping the  node 0,1 which is i=1
-                if (i == 1)
-                    ++nodePtr;
+    //the currents and field of the previous query are no longer valid,
+    //and the new ones belong to the current map
+    context.x.clear();
+    context.fieldReady = false;
+    context.mapGeneration = mapGeneration;
 
-                nodei = nodePtr / cols;
-                nodej = nodePtr % cols;
+    //the temporaries of the solvers come from the arena of the context
+    Arena::Scope scope(context.arena);
 
-                //if we are at the top border
-                if (nodePtr % cols == nodePtr)
-                {
-                    //if we are at the top left corner
-                    if (nodePtr == 0)
-                    {
-                        //outgoin right
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
+    //the nodal analysis has one unknown per node instead of one per resistor
+    if (solverMethod != MeshSparseLU)
+    {
+        return navigateNodal(startNode, endNode, context);
+    }
 
-                        //outgoing down
-                        A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                    }
-                    //we are at the top right corner
-                    else if (nodePtr == cols - 1)
-                    {
-                        //incoming left
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                        //outgoing down
-                        A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                    }
-                    else
-                    {
-                        //incoming left
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                        //outgoing down
-                        A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                        //outgoing right
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                    }
-                }
-                //if we are at the left border
-                else if (nodePtr % cols == 0)
-                {
-                    //if we are at the bottom left corner
-                    if (nodePtr / cols == rows - 1)
-                    {
-                        //incoming up
-                        A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                        //outgoing right
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                    }
-                    else
-                    {
-                        //incoming up
-                        A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                        //outgoing right
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                        //outfoing down
-                        A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                    }
-                }
-                //if we are at the right border
-                else if (nodePtr % cols == cols - 1)
-                {
+    //one node equation is redundant: the one of the end node, where the
+    //current injected at the start node leaves the grid, is dropped.
+    //The nodes after it are shifted up one row
+    const int skipped = endNode;
+    auto nodeRow = [skipped](const int node) { return node - int(node > skipped); };
 
-                    //if we are at the bottom right corner
-                    if (nodePtr / cols == rows)
-                    {
-                        //incoming up
-                        A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                        //incoming left
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                    }
-                    else
-                    {
-                        //incoming up
-                        A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                        //outgoing down
-                        A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                        //incoming left
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                    }
-                }
+    context.b.assign(resistors, 0.0);
+    context.b[nodeRow(startNode)] = 1;
 
-                //if we are at the bottom border
-                else if (nodePtr / cols == rows)
-                {
-                    //all corners have been checked
-                    //incoming up
-                    A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                    //outgoing right
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                    //incoming left
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                }
+    //each node equation involves the resistors of its neighbours, each
+    //mesh equation the four resistors around a cell of the grid
+    assert(nodeEquationNum - 1 + gridEquationNum == resistors);
+    std::vector<size_t> entries(resistors, 4u);
+    for (int node = 0; node < nodeEquationNum; ++node)
+    {
+        if (node == skipped)
+            continue;
+        nodei = node / cols;
+        nodej = node % cols;
+        entries[nodeRow(node)] = size_t(nodei > 0) + size_t(nodej > 0) +
+                                size_t(nodej < cols - 1) + size_t(nodei < rows - 1);
+    }
+    context.A.allocateRows(resistors, entries);
 
-                else
-                {
-                    //incoming up
-                    A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                    //incoming left
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                    //outgoing down
-                    A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                    //outgoing right
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                }
-                //increment pointer to current node
-                ++nodePtr;
-            } //end of for-------------------------------------------------------------------------------------------
-        }     //end of eliminate 0,1
+    //the rows are independent, so they are filled in parallel
+    const size_t band = 2 * cols - 1;
 
-        //we eliminate equation for nod123e n,m
-        else
+    //************************************************* node equations ************************************************************************************
+    //the current leaving the node: incoming from up and left, outgoing to
+    //the right and down.  The columns are in ascending order
+    auto nodeEquation = [&](const int i, const int j,
+                            const bool up, const bool left,
+                            const bool right, const bool down) {
+        const size_t r = size_t(i) * band + size_t(j); //resistor to the right
+        size_t col[4];
+        double val[4];
+        int n = 0;
+        if (up)
         {
-            //since we are removing the last equation the indexes of the star andindex nodes remain the same
-            b[startNode] = 1;
-            b[endNode] = -1;
-
-            // because we are skipping the last node n,m which is i=nodeEquationNum-1
-            nodePtr = 0;
-
-            for (int i = 0; i < nodeEquationNum - 1; ++i)
-            {
-
-                nodei = nodePtr / cols;
-                nodej = nodePtr % cols;
-                //if we are at the top border
-                if (nodePtr % cols == nodePtr)
-                {
-                    //if we are at the top left corner
-                    if (nodePtr == 0)
-                    {
-                        //outgoing right
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-
-                        //outgoing down
-                        A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                    }
-                    //we are at the top right corner
-                    else if (nodePtr == cols - 1)
-                    {
-                        //incoming left
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                        //outgoing down
-                        A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                    }
-                    else
-                    {
-                        //incoming left
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                        //outgoing down
-                        A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                        //outgoing right
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                    }
-                }
-
-                //if we are at the left border
-                else if (nodePtr % cols == 0)
-                {
-                    //if we are at the bottom left corner
-                    if (nodePtr / cols == rows - 1)
-                    {
-                        //incoming up
-                        A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                        //outgoing right
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                    }
-                    else
-                    {
-                        //incoming up
-                        A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                        //outgoing right
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                        //outfoing down
-                        A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                    }
-                }
-                //if we are at the right border
-                else if (nodePtr % cols == cols - 1)
-                {
-
-                    //if we are at the bottom right corner
-                    if (nodePtr / cols == rows - 1)
-                    {
-                        //do nothing should never get here
-                    }
-                    else
-                    {
-                        //incoming up
-                        A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                        //outgoing down
-                        A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                        //incoming left
-                        A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                    }
-                }
-                //if we are at the bottom border
-                else if (nodePtr / cols == rows - 1)
-                {
-                    //all corners have been checked
-                    //incoming up
-                    A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                    //outgoing right
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                    //incoming left
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                }
-
-                else
-                {
-                    //incoming up
-                    A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                    //incoming left
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                    //outgoing down
-                    A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                    //outgoing right
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                }
-                //increment pointer to current node
-                ++nodePtr;
-            } //end of for-----------------------------------------------------------------------------------
-        }     //end of eliminate n,m
-    }
+            col[n] = r - band + cols - 1;
+            val[n++] = -1;
+        }
+        if (left)
+        {
+            col[n] = r - 1;
+            val[n++] = -1;
+        }
+        if (right)
+        {
+            col[n] = r;
+            val[n++] = 1;
+        }
+        if (down)
+        {
+            col[n] = r + cols - 1;
+            val[n++] = 1;
+        }
+        context.A.setRow(nodeRow(i * cols + j), col, val);
+    };
 
-    //we eliminate equation for node 0,0
-    else
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < rows; ++i)
     {
-        //since we are removing the first equation the indexes of the start and end nodes have to be reduced by 1
-        b[startNode - 1] = 1;
-        b[endNode - 1] = -1;
+        //the borders are handled out of the loop over the interior
+        const bool up = (i > 0), down = (i < rows - 1);
 
-        for (int i = 0; i < nodeEquationNum - 1; ++i)
+        if (cols == 1)
         {
-            // because we are skipping node 0,0 which is i=0
-            nodePtr = i + 1;
-
-            nodei = nodePtr / cols;
-            nodej = nodePtr % cols;
-            //if we are at the top border
-            if (nodePtr % cols == nodePtr)
-            {
-                //we are at the top right corner
-                if (nodePtr == cols - 1)
-                {
-                    //incoming left
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                    //outgoing down
-                    A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                }
-                else
-                {
-                    //incoming left
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                    //outgoing down
-                    A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                    //outgoing right
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                } //we don't check for node 0,0 since we are skipping it
-            }
-            //if we are at the left border
-            else if (nodePtr % cols == 0)
-            {
-                //if we are at the bottom left corner
-                if (nodePtr / cols == rows - 1)
-                {
-                    //incoming up
-                    A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                    //outgoing right
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                }
-                else
-                {
-                    //incoming up
-                    A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                    //outgoing right
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                    //outfoing down
-                    A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                }
-            }
-            //if we are at the right border
-            else if (nodePtr % cols == cols - 1)
-            {
-
-                //if we are at the bottom right corner
-                if (nodePtr / cols == rows - 1)
-                {
-                    //incoming up
-                    A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                    //outgoing left
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                }
-                else
-                {
-                    //incoming up
-                    A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                    //outgoing down
-                    A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                    //incoming left
-                    A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                }
-            }
-            //if we are at the bottom border
-            else if (nodePtr / cols == rows - 1)
-            {
-                //all corners have been checked
-                //incoming up
-                A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                //outgoing right
-                A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-                //incoming left
-                A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-            }
-
-            //not on a border and not a corner
-            else
-            {
-                //incoming up
-                A[i][nodesToIndex(nodei, nodej, nodei - 1, nodej)] = -1;
-                //incoming left
-                A[i][nodesToIndex(nodei, nodej, nodei, nodej - 1)] = -1;
-                //outgoing down
-                A[i][nodesToIndex(nodei, nodej, nodei + 1, nodej)] = 1;
-                //outgoing right
-                A[i][nodesToIndex(nodei, nodej, nodei, nodej + 1)] = 1;
-            }
-        } //end of for
-    }     //end of eliminate node 0,0
+            if (i != skipped)
+                nodeEquation(i, 0, up, false, false, down);
+            continue;
+        }
 
-    //********************************** end of node equations *****************************************************************************************
+        const int node = i * cols;
+        if (node != skipped)
+            nodeEquation(i, 0, up, false, true, down);
+        for (int j = 1; j < cols - 1; ++j)
+        {
+            if (node + j != skipped)
+                nodeEquation(i, j, up, true, true, down);
+        }
+        if (node + cols - 1 != skipped)
+            nodeEquation(i, cols - 1, up, true, false, down);
+    }
 
     //############################### begin grid equations ###############################################
-    int gridPtr = 0;
-    int currBand, numGridBand, r1, r2, r3, r4;
-    int bandSize = 2 * cols - 1;
-
-    //fill the last part of A matrix, we skipped one equation from the nodes equations so we start from
-    //nodeEquationNum - 1
-    for (int i = nodeEquationNum - 1; i < nodeEquationNum + gridEquationNum - 1; ++i)
+    //the voltage around each cell is zero, going clockwise through the
+    //resistors on top, right, bottom and left
+    const int meshCols = cols - 1;
+    const double *res = resistances.data();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < rows - 1; ++i)
     {
-        //the amount of grids per band is n-1 where n is the amount of columns
-        currBand = gridPtr / (cols - 1);
-
-        //the position of the grid witthin the band from 0 to n-2
-        numGridBand = gridPtr % (cols - 1);
-
-        r1 = currBand * (bandSize) + numGridBand;
-        r2 = r1 + cols;
-        r3 = r1 + (bandSize);
-        r4 = r1 + cols - 1;
-
-        A[i][r1] = getResistanceValue(r1);
-        A[i][r2] = getResistanceValue(r2);
-        A[i][r3] = getResistanceValue(r3) * (-1);
-        A[i][r4] = getResistanceValue(r4) * (-1);
-
-        //increment the current grid equation pointer
-        ++gridPtr;
+        size_t col[4];
+        double val[4];
+        for (int j = 0; j < meshCols; ++j)
+        {
+            const size_t top = size_t(i) * band + size_t(j);
+            col[0] = top;
+            col[1] = top + cols - 1; //left
+            col[2] = top + cols;     //right
+            col[3] = top + band;     //bottom
+            val[0] = res[col[0]];
+            val[1] = -res[col[1]];
+            val[2] = res[col[2]];
+            val[3] = -res[col[3]];
+            context.A.setRow(nodeEquationNum - 1 + i * meshCols + j, col, val);
+        }
     }
     //############################## end grid equations #################################
 
     //solve the equation system
-    anpi::solveLU(A, x, b);
+    anpi::solveSparseLU(context.A, context.x, context.b);
 
     //calculate simple path
     // calculateSimplePath(nodes);
@@ -476,688 +411,911 @@ bool ResistorGrid::navigate(const indexPair &nodes)
 } // namespace anpi
 
 /**
-∗ compute an index number representig the resistor located in the provided indices. 
-* this method works when the indices row1 and col1 are equal or less than the row2
-* and col2 indexes, that is the initial node is the one with the lowest indexes.
-* this method assumes that the provided indexes are contiguos(i.e. they don't exceed
-* +1 in only one of the indexes, row or column)
-*/
-std::size_t ResistorGrid::nodesToIndex(const std::size_t row1, const std::size_t col1, const std::size_t row2, const std::size_t col2)
+ * Assemble the nodal matrix of the current map.
+ *
+ * The unknowns are the potentials of the nodes.  Each node equation
+ * states that the sum of the currents leaving through its resistors,
+ * (V_node - V_neighbour) / R, equals the current injected in it.  The
+ * potential of node 0 is fixed to zero, which turns the resulting
+ * Laplacian matrix into a symmetric positive definite one.  The
+ * multigrid solver takes the floating Laplacian instead, whose
+ * potentials are determined up to a constant; only their differences
+ * are used.  Grounding a single node makes the system nearly singular
+ * for the smoother, and the multigrid cycles needed grow faster with
+ * the size of the map.
+ *
+ * Since the nodes form a regular lattice, the Laplacian is assembled as
+ * a five-point grid operator.  It is used directly by the multigrid
+ * solver, or converted into a sparse matrix for the preconditioned
+ * conjugate gradient and the Cholesky factorization.  The preconditioner
+ * of the conjugate gradient is set up here as well.
+ *
+ * None of this depends on the start and end nodes, so it is done only
+ * once per map and solver.
+ */
+void ResistorGrid::prepareNodal()
 {
-    //horizontal
-    if (row1 == row2)
+    const int cols = rawMap.cols(), rows = rawMap.rows();
+    const int nodes = cols * rows;
+    const int ground = 0;
+
+    //the couplings of each node are stored with its right and lower neighbours
+    laplacian.allocate(rows, cols);
+
+    double g;
+    for (int node = 0; node < nodes; ++node)
     {
-        if (col2 < col1) // we have the indexes ordered backwards
-        {
+        const NodeResistors &around = nodeResistors(node);
 
-            return nodesToIndex(row2, col2, row1, col1);
+        //right
+        if (around.right != NoResistor)
+        {
+            g = conductances[around.right];
+            laplacian.diag[node] += g;
+            laplacian.diag[node + 1] += g;
+            laplacian.east[node] = g;
         }
-
-        //if not contiguos
-        if (col2 != col1 + 1)
+        //down
+        if (around.down != NoResistor)
         {
-            //throw exception
-            throw anpi::Exception("Indexes provided are not contiguos\n");
+            g = conductances[around.down];
+            laplacian.diag[node] += g;
+            laplacian.diag[node + cols] += g;
+            laplacian.south[node] = g;
         }
+    }
 
-        return col1 + row1 * (2 * rawMap.cols() - 1);
+    //the grounded node is decoupled from its neighbours
+    if (solverMethod != NodalMultigrid)
+    {
+        laplacian.diag[ground] = 1.0;
+        laplacian.east[ground] = 0.0;
+        laplacian.south[ground] = 0.0;
     }
-    //vertical
-    else if (col1 == col2)
+
+    switch (solverMethod)
     {
-        if (row2 < row1) // we have the indexes ordered backwards
+    case NodalMultigrid:
+        multigrid.setup(laplacian, mgSettings);
+        break;
+    case NodalCholesky:
+        laplacian.toSparse(A);
+        if (SparseCholesky<double>::profileEntries(A) > CholeskyMaxEntries)
         {
-
-            return nodesToIndex(row2, col2, row1, col1);
+            throw anpi::Exception("ResistorGrid: map too large for NodalCholesky, "
+                                  "use NodalMultigrid");
         }
-        //if not contiguos
-        if (row2 != row1 + 1)
+        if (!loadCachedFactorization(A))
         {
-            //throw
-            throw anpi::Exception("Indexes provided are not contiguos\n");
+            cholesky.factor(A);
+            storeCachedFactorization();
         }
-
-        return col1 + (rawMap.cols() - 1) + row1 * (2 * rawMap.cols() - 1);
+        break;
+    default:
+        laplacian.toSparse(A);
+        cgPreconditioner.setup(A, cgSettings.preconditioner);
+        break;
     }
-    //indexes are not contiguos
-    else
+
+    nodalMethod = solverMethod;
+    nodalReady = true;
+}
+
+/**
+ * The key hashes everything the factorization depends on: the size and
+ * pixels of the map (without the row padding), the resistance model,
+ * the solver method and the version of the cached data.
+ */
+std::string ResistorGrid::cacheFile() const
+{
+    std::uint64_t h = 14695981039346656037ull;
+    h = hashValue(CacheVersion, h);
+    h = hashValue(std::uint64_t(solverMethod), h);
+    h = hashValue(std::uint64_t(rawMap.rows()), h);
+    h = hashValue(std::uint64_t(rawMap.cols()), h);
+    h = hashBytes(resistanceModel.levels().data(),
+                  resistanceModel.levels().size() * sizeof(float), h);
+    for (size_t i = 0; i < rawMap.rows(); ++i)
     {
-        //throw exception
-        throw anpi::Exception("Indexes provided are not contiguos\n");
+        h = hashBytes(rawMap[i], rawMap.cols() * sizeof(float), h);
     }
-    return 0;
+
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << h << ".chol";
+    return (boost::filesystem::path(cacheDirectory) / name.str()).string();
 }
 
 /**
-∗ compute the indices of the resistor given the numerical representation of it
-*/
-indexPair ResistorGrid::indexToNodes(const std::size_t idx)
+ * A missing, unreadable or invalid entry is not an error: the
+ * factorization is just computed again.  So is an entry whose profile
+ * differs from the one of the nodal matrix, which may be left by an
+ * older version of the assembly or by a collision of the hash.
+ */
+bool ResistorGrid::loadCachedFactorization(const SparseMatrix<double> &nodal)
 {
-    //resistor does not exist in the grid
-    if (idx > rawMap.cols() * rawMap.rows() * 2 - (rawMap.cols() + rawMap.rows()))
+    if (cacheDirectory.empty())
+        return false;
+
+    std::ifstream in(cacheFile(), std::ios::binary);
+    if (!in)
+        return false;
+
+    try
     {
-        //throw exception
-        throw anpi::Exception("Resistor does not exist. Index exceeds the amount of resistors\n");
+        cholesky.load(in);
+    }
+    catch (anpi::Exception &)
+    {
+        return false;
     }
-    indexPair res;
 
-    //the amount of resistors in a line of nodes, i.e. for n columns
-    //we have n-1 horizontal and n vertical resistors for a total of
-    // 2n - 1 total resistors
-    int blockSize = 2 * rawMap.cols() - 1;
+    return cholesky.hasProfileOf(nodal);
+}
 
-    //amount of horizontal resistors
-    int rowsize = rawMap.cols() - 1;
+/**
+ * The entry is written to a temporary file which is then renamed, so
+ * that concurrent processes never read a partial entry.  Failing to
+ * write the cache does not affect the navigation.
+ */
+void ResistorGrid::storeCachedFactorization() const
+{
+    if (cacheDirectory.empty())
+        return;
 
-    res.row1 = idx / blockSize;
+    namespace fs = boost::filesystem;
+    boost::system::error_code ec;
 
-    int posCol = idx % blockSize;
+    fs::create_directories(cacheDirectory, ec);
+    const fs::path target(cacheFile());
+    const fs::path tmp = fs::unique_path(target.string() + ".%%%%-%%%%.tmp", ec);
+    if (ec)
+        return;
 
-    //vertical
-    if (posCol > (rowsize - 1)) //we use rowsize-1 becuase we start counting resistors from 0
+    try
     {
-        res.col2 = res.col1 = posCol - rowsize;
-        res.row2 = res.row1 + 1;
-        return res;
+        std::ofstream out(tmp.string(), std::ios::binary | std::ios::trunc);
+        cholesky.save(out);
+        out.close();
+        if (!out)
+            throw anpi::Exception("Cannot write cache entry");
     }
-    //horizontal
-    else
+    catch (anpi::Exception &)
     {
-        res.col1 = posCol;
-        res.col2 = posCol + 1;
-        res.row2 = res.row1;
-        return res;
+        fs::remove(tmp, ec);
+        return;
     }
 
-    return res;
+    fs::rename(tmp, target, ec);
+    if (ec)
+        fs::remove(tmp, ec);
 }
 
-/**
- * Compute the value of the resitance given by the provided index
- * 
- * 
- * 
- **/
-
-int ResistorGrid::getResistanceValue(int indx)
+void ResistorGrid::prepare()
 {
-    indexPair resIndex = indexToNodes(indx);
-
-    //if one of the nodes is 0 there is a high resistance
-    if ((rawMap[resIndex.row1][resIndex.col1] == BLACK) || (rawMap[resIndex.row2][resIndex.col2] == BLACK))
+    if ((solverMethod != MeshSparseLU) && (!nodalReady || (nodalMethod != solverMethod)))
     {
-        return MEGAOHM;
+        prepareNodal();
     }
-    else
-        return OHM;
 }
 
 /**
-∗ Compute a rute of more current and create a matrix for print.
-*Se necesita hacer pruebas
-*/
-void ResistorGrid::calculateSimplePath(const indexPair &nodes)
+ * Solve the grid with nodal analysis.
+ *
+ * The current injected is 1 at the start node and -1 at the end node;
+ * the grounded node absorbs the current injected at it, except for the
+ * floating system of the multigrid solver.  Only this
+ * right hand side changes between navigations on the same map, so the
+ * prepared nodal system is reused.
+ *
+ * The currents of all resistors are then stored in x, with the same
+ * layout and sign convention used by the mesh formulation.
+ */
+bool ResistorGrid::navigateNodal(const int startNode, const int endNode,
+                                 NavigationContext &context) const
 {
-    int cols = rawMap.cols();
-    int rows = rawMap.rows();
-    int startNode = nodes.row1 * cols + nodes.col1;
-    int endNode = nodes.row2 * cols + nodes.col2;
-    // int nodeEquationNum = cols * rows; // amount of node equations
-    int nodei, nodej; //indexes for the node pointer
-    int pastPtr = -1, nodePtr = startNode;
-    std::vector<int> vectPath, outCurrents;
-    int iUp, iDown, iRight, iLeft, iMax;
-    indexPair moveRes;
+    const int cols = rawMap.cols(), rows = rawMap.rows();
+    const int nodes = cols * rows;
+    const int ground = (solverMethod == NodalMultigrid) ? -1 : 0;
 
-    while (nodePtr != endNode)
+    if (!nodalReady || (nodalMethod != solverMethod))
     {
+        throw anpi::Exception("ResistorGrid: the nodal system is not prepared, call prepare() first");
+    }
 
-        nodei = nodePtr / cols;
-        nodej = nodePtr % cols;
+    std::vector<double> &b = context.b;
+    b.assign(nodes, 0.0);
+    if (startNode != ground)
+        b[startNode] = 1;
+    if (endNode != ground)
+        b[endNode] = -1;
 
-        outCurrents.clear();
-        //we check where in the matrix is the current node to see which currents to compare
+    switch (solverMethod)
+    {
+    case NodalMultigrid:
+        //the hierarchy is shared, the cycles run in the context
+        context.potentials.clear();
+        multigrid.solve(context.potentials, b, context.multigridWorkspace);
+        break;
+    case NodalCholesky:
+        cholesky.solve(b, context.potentials);
+        break;
+    default:
+        context.potentials.clear();
+        anpi::solveCG(A, context.potentials, b, cgPreconditioner, cgSettings);
+        break;
+    }
 
-        //if we are at the top border
-        if (nodePtr % cols == nodePtr)
-        {
-            //if we are at the top left corner
-            if (nodePtr == 0)
-            {
-                //incoming right
-                iRight = nodesToIndex(nodei, nodej, nodei, nodej + 1);
+    currentsFromPotentials(context.potentials, context.x);
+    return true;
+}
 
-                //outgoing down
-                iDown = nodesToIndex(nodei, nodej, nodei + 1, nodej);
+/**
+ * The current flows from the first to the second node of each resistor
+ * if it is positive, as in the mesh formulation.
+ */
+void ResistorGrid::currentsFromPotentials(const std::vector<double> &pot,
+                                          std::vector<double> &currents) const
+{
+    const std::size_t resistors = resistorNodeTable.size();
+    currents.resize(resistors);
+    for (std::size_t r = 0; r < resistors; ++r)
+    {
+        const ResistorNodes &ends = resistorNodes(r);
+        currents[r] = (pot[ends.first] - pot[ends.second]) * conductances[r];
+    }
+}
 
-                if (x[iRight] < 0)
-                {
-                    outCurrents.push_back(iRight);
-                }
-                if (x[iDown] > 0)
-                {
-                    outCurrents.push_back(iDown);
-                }
+/**
+ * The map preprocessing and the factorization, preconditioner or
+ * multigrid hierarchy of the nodal system are shared by all queries.
+ * The right hand sides are solved in blocks of BatchBlock, all together
+ * with the Cholesky factor, or in parallel with conjugate gradient or
+ * with multigrid cycles, each thread with its own cycle workspace.  The
+ * paths of each block are then extracted in parallel.
+ *
+ * The mesh system depends on the end node, so with MeshSparseLU each
+ * query is assembled and solved on its own, in parallel.
+ */
+std::vector<NavigationResult> ResistorGrid::navigateBatch(const std::vector<indexPair> &queries,
+                                                          const bool smooth)
+{
+    const std::size_t cols = rawMap.cols(), nodes = nodeResistorTable.size();
+    if (nodes == 0)
+        throw anpi::Exception(" No raw map loaded\n");
 
-                //calculate maximun current
-                if (pastPtr == iRight)
-                    iMax = iDown;
-                else if (pastPtr == iDown)
-                    iMax = iRight;
+    std::vector<std::size_t> starts(queries.size()), ends(queries.size());
+    for (std::size_t q = 0; q < queries.size(); ++q)
+    {
+        starts[q] = queries[q].row1 * cols + queries[q].col1;
+        ends[q] = queries[q].row2 * cols + queries[q].col2;
+        if ((starts[q] >= nodes) || (ends[q] >= nodes))
+            throw anpi::Exception("Start or End node out of bounds, node does not exist\n");
+        if (starts[q] == ends[q])
+            throw anpi::Exception("Start and End nodes are the same, no path to navigate\n");
+    }
 
-                else
-                    // iMax = calcCurrent(iDown, iRight);
-                    iMax = maxCurrent(outCurrents);
-            }
-            //we are at the top right corner
-            else if (nodePtr == cols - 1)
-            {
-                //incoming left
-                iLeft = nodesToIndex(nodei, nodej, nodei, nodej - 1);
-                //outgoing down
-                iDown = nodesToIndex(nodei, nodej, nodei + 1, nodej);
+    std::vector<NavigationResult> results(queries.size());
+
+    if (solverMethod == MeshSparseLU)
+    {
+        //each thread assembles and solves the systems in its own context
+        ParallelErrors errors;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+        {
+            NavigationContext context;
 
-                if (x[iLeft] < 0)
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (std::ptrdiff_t q = 0; q < std::ptrdiff_t(queries.size()); ++q)
+            {
+                try
                 {
-                    outCurrents.push_back(iLeft);
+                    navigate(queries[q], context);
+                    calculateSimplePath(queries[q], context);
+                    results[q].simplePath.swap(context.simplePath);
+                    if (smooth)
+                    {
+                        calculateSmoothPath(queries[q], context);
+                        results[q].smoothPath.swap(context.smoothPath);
+                    }
                 }
-                if (x[iDown] > 0)
+                catch (...)
                 {
-                    outCurrents.push_back(iDown);
+                    errors.capture();
                 }
+            }
+        }
+
+        errors.rethrow();
+        return results;
+    }
 
-                //calculate maximun current
-                if (pastPtr == iLeft)
-                    iMax = iDown;
-                else if (pastPtr == iDown)
-                    iMax = iLeft;
+    prepare();
+
+    //the multigrid solver has no grounded node
+    const std::size_t ground = (solverMethod == NodalMultigrid) ? nodes : 0;
+    for (std::size_t first = 0; first < queries.size(); first += BatchBlock)
+    {
+        const std::size_t count = std::min(BatchBlock, queries.size() - first);
 
-                else
-                    // iMax = calcCurrent(iDown, iLeft);
-                    iMax = maxCurrent(outCurrents);
+        //potentials of all queries of the block
+        std::vector<std::vector<double>> pot(count);
+        if (solverMethod == NodalCholesky)
+        {
+            Matrix<double> rhs(nodes, count, 0.0), solution;
+            for (std::size_t k = 0; k < count; ++k)
+            {
+                if (starts[first + k] != ground)
+                    rhs(starts[first + k], k) = 1;
+                if (ends[first + k] != ground)
+                    rhs(ends[first + k], k) = -1;
             }
-            else
+            cholesky.solve(rhs, solution);
+            for (std::size_t k = 0; k < count; ++k)
             {
-                //incoming left
-                iLeft = nodesToIndex(nodei, nodej, nodei, nodej - 1);
-                //outgoing down
-                iDown = nodesToIndex(nodei, nodej, nodei + 1, nodej);
-                //outgoing right
-                iRight = nodesToIndex(nodei, nodej, nodei, nodej + 1);
-
-                if (x[iLeft] < 0)
-                {
-                    outCurrents.push_back(iLeft);
-                }
-                if (x[iDown] > 0)
-                {
-                    outCurrents.push_back(iDown);
-                }
-                if (x[iRight] > 0)
-                {
-                    outCurrents.push_back(iRight);
-                }
-
-                //calculate maximun current
-                if (pastPtr == iRight)
-                    iMax = calcCurrent(iDown, iLeft);
-                else if (pastPtr == iDown)
-                    iMax = calcCurrent(iRight, iLeft);
-                else if (pastPtr == iLeft)
-                    iMax = calcCurrent(iDown, iRight);
-                else
-
-                    // iMax = calcCurrent(iDown, iRight, iLeft);
-                    iMax = maxCurrent(outCurrents);
+                pot[k].resize(nodes);
+                for (std::size_t i = 0; i < nodes; ++i)
+                    pot[k][i] = solution(i, k);
             }
         }
-        //if we are at the left border
-        else if (nodePtr % cols == 0)
+        else
         {
-            //if we are at the bottom left corner
-            if (nodePtr / cols == rows - 1)
+            std::vector<std::vector<double>> rhs(count, std::vector<double>(nodes, 0.0));
+            for (std::size_t k = 0; k < count; ++k)
             {
-                //incoming up
-                iUp = nodesToIndex(nodei, nodej, nodei - 1, nodej);
-                //outgoing right
-                iRight = nodesToIndex(nodei, nodej, nodei, nodej + 1);
+                if (starts[first + k] != ground)
+                    rhs[k][starts[first + k]] = 1;
+                if (ends[first + k] != ground)
+                    rhs[k][ends[first + k]] = -1;
+            }
 
-                if (x[iUp] < 0)
+            if (solverMethod == NodalMultigrid)
+            {
+                //the hierarchy is shared, the cycles of each thread run
+                //in their own workspace
+                ParallelErrors errors;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
                 {
-                    outCurrents.push_back(iUp);
-                }
+                    Multigrid<double>::Workspace workspace;
 
-                if (x[iRight] > 0)
-                {
-                    outCurrents.push_back(iRight);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+                    for (std::ptrdiff_t k = 0; k < std::ptrdiff_t(count); ++k)
+                    {
+                        try
+                        {
+                            multigrid.solve(pot[k], rhs[k], workspace);
+                        }
+                        catch (...)
+                        {
+                            errors.capture();
+                        }
+                    }
                 }
-                //calculate maximun current
-                if (pastPtr == iUp)
-                    iMax = iRight;
-                else if (pastPtr == iRight)
-                    iMax = iUp;
-                else
-                    // iMax = calcCurrent(iUp, iRight);
-                    iMax = maxCurrent(outCurrents);
+                errors.rethrow();
             }
             else
             {
-                //incoming up
-                iUp = nodesToIndex(nodei, nodej, nodei - 1, nodej);
-                //outgoing right
-                iRight = nodesToIndex(nodei, nodej, nodei, nodej + 1);
+                anpi::solveCG(A, pot, rhs, cgPreconditioner, cgSettings);
+            }
+        }
 
-                //outgoing down
-                iDown = nodesToIndex(nodei, nodej, nodei + 1, nodej);
+        //the paths of the block, each with its own buffers
+        ParallelErrors errors;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+        {
+            std::vector<double> currents;
+            Matrix<float> dx, dy;
 
-                if (x[iUp] < 0)
-                {
-                    outCurrents.push_back(iUp);
-                }
-                if (x[iDown] > 0)
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (std::ptrdiff_t k = 0; k < std::ptrdiff_t(count); ++k)
+            {
+                const std::size_t q = first + std::size_t(k);
+                try
                 {
-                    outCurrents.push_back(iDown);
+                    currentsFromPotentials(pot[k], currents);
+                    simplePathOf(currents, starts[q], ends[q], results[q].simplePath);
+                    if (smooth)
+                    {
+                        currentField(currents, dx, dy);
+                        smoothPathOf(currents, dx, dy, queries[q], results[q].smoothPath);
+                    }
                 }
-                if (x[iRight] > 0)
+                catch (...)
                 {
-                    outCurrents.push_back(iRight);
+                    errors.capture();
                 }
-
-                //calculate maximun current
-                if (pastPtr == iRight)
-                    iMax = calcCurrent(iDown, iUp);
-                else if (pastPtr == iDown)
-                    iMax = calcCurrent(iRight, iUp);
-                else if (pastPtr == iUp)
-                    iMax = calcCurrent(iDown, iRight);
-
-                else
-                    //calculate maximun current
-                    // iMax = calcCurrent(iUp, iDown, iRight);
-                    iMax = maxCurrent(outCurrents);
             }
         }
-        //if we are at the right border
-        else if (nodePtr % cols == cols - 1)
-        {
 
-            //if we are at the bottom right corner
-            if (nodePtr / cols == rows - 1)
-            {
-                //incoming up
-                iUp = nodesToIndex(nodei, nodej, nodei - 1, nodej);
-                //outgoing left
-                iLeft = nodesToIndex(nodei, nodej, nodei, nodej - 1);
+        errors.rethrow();
+    }
 
-                if (x[iLeft] > 0)
-                {
-                    outCurrents.push_back(iLeft);
-                }
-                if (x[iUp] < 0)
-                {
-                    outCurrents.push_back(iUp);
-                }
+    return results;
+}
 
-                //calculate maximun current
-                if (pastPtr == iUp)
-                    iMax = iLeft;
-                else if (pastPtr == iLeft)
-                    iMax = iUp;
-                else
-                    // iMax = calcCurrent(iUp, iLeft);
-                    iMax = maxCurrent(outCurrents);
-            }
-            else
-            {
-                //incoming up
-                iUp = nodesToIndex(nodei, nodej, nodei - 1, nodej);
-                //outgoing down
-                iDown = nodesToIndex(nodei, nodej, nodei + 1, nodej);
-                //incoming left
-                iLeft = nodesToIndex(nodei, nodej, nodei, nodej - 1);
-
-                if (x[iLeft] < 0)
-                {
-                    outCurrents.push_back(iLeft);
-                }
-                if (x[iUp] < 0)
-                {
-                    outCurrents.push_back(iUp);
-                }
-                if (x[iDown] > 0)
-                {
-                    outCurrents.push_back(iDown);
-                }
+/**
+∗ compute an index number representig the resistor located in the provided indices. 
+* The nodes can be given in any order, but must be neighbours in the same row
+* or column of the map.
+*/
+std::size_t ResistorGrid::nodesToIndex(const std::size_t row1, const std::size_t col1, const std::size_t row2, const std::size_t col2) const
+{
+    const std::size_t cols = rawMap.cols(), rows = rawMap.rows();
+    if ((row1 >= rows) || (row2 >= rows) || (col1 >= cols) || (col2 >= cols))
+    {
+        throw anpi::Exception("Node does not exist in the grid\n");
+    }
 
-                //calculate maximun current
-                if (pastPtr == iUp)
-                    iMax = calcCurrent(iDown, iLeft);
-                else if (pastPtr == iDown)
-                    iMax = calcCurrent(iUp, iLeft);
-                else if (pastPtr == iLeft)
-                    iMax = calcCurrent(iDown, iUp);
-                else
-                    // iMax = calcCurrent(iUp, iDown, iLeft);
-                    iMax = maxCurrent(outCurrents);
-            }
-        }
-        //if we are at the bottom border
-        else if (nodePtr / cols == rows - 1)
-        {
-            //all corners have been checked
-            //incoming up
-            iUp = nodesToIndex(nodei, nodej, nodei - 1, nodej);
-            //outgoing right
-            iRight = nodesToIndex(nodei, nodej, nodei, nodej + 1);
-            //incoming left
-            iLeft = nodesToIndex(nodei, nodej, nodei, nodej - 1);
-
-            if (x[iLeft] < 0)
-            {
-                outCurrents.push_back(iLeft);
-            }
-            if (x[iUp] < 0)
-            {
-                outCurrents.push_back(iUp);
-            }
-            if (x[iRight] > 0)
-            {
-                outCurrents.push_back(iRight);
-            }
+    //the resistor is stored with the upper or left node
+    const std::size_t node1 = row1 * cols + col1, node2 = row2 * cols + col2;
+    const NodeResistors &around = nodeResistorTable[std::min(node1, node2)];
+    const std::size_t distance = (node1 < node2) ? node2 - node1 : node1 - node2;
 
-            //calculate maximun current
-            if (pastPtr == iRight)
-                iMax = calcCurrent(iUp, iLeft);
-            else if (pastPtr == iUp)
-                iMax = calcCurrent(iRight, iLeft);
-            else if (pastPtr == iLeft)
-                iMax = calcCurrent(iUp, iRight);
+    //horizontal
+    if ((row1 == row2) && (distance == 1))
+    {
+        return around.right;
+    }
+    //vertical
+    if ((col1 == col2) && (distance == cols))
+    {
+        return around.down;
+    }
 
-            else
-                // iMax = calcCurrent(iUp, iRight, iLeft);
-                iMax = maxCurrent(outCurrents);
-        }
+    //indexes are not contiguos
+    throw anpi::Exception("Indexes provided are not contiguos\n");
+}
 
-        //not on a border and not a corner
-        else
+/**
+∗ compute the indices of the resistor given the numerical representation of it
+*/
+indexPair ResistorGrid::indexToNodes(const std::size_t idx) const
+{
+    //resistor does not exist in the grid
+    if (idx >= resistorNodeTable.size())
+    {
+        //throw exception
+        throw anpi::Exception("Resistor does not exist. Index exceeds the amount of resistors\n");
+    }
+
+    const std::size_t cols = rawMap.cols();
+    const ResistorNodes &ends = resistorNodeTable[idx];
+
+    indexPair res;
+    res.row1 = ends.first / cols;
+    res.col1 = ends.first % cols;
+    res.row2 = ends.second / cols;
+    res.col2 = ends.second % cols;
+    return res;
+}
+
+/**
+ * The resistors of each row of nodes are numbered in blocks of
+ * 2 * cols - 1: first the cols - 1 horizontal ones, joining each node
+ * with its right neighbour, and then the cols vertical ones, joining it
+ * with the node below.
+ */
+void ResistorGrid::computeIndexTables()
+{
+    const std::size_t cols = rawMap.cols(), rows = rawMap.rows();
+    const std::size_t nodes = rows * cols;
+    const std::size_t block = 2 * cols - 1;
+
+    discardNavigation();
+    nodeResistorTable.resize(nodes);
+    resistorNodeTable.resize((nodes == 0) ? 0 : nodes * 2 - (cols + rows));
+
+    for (std::size_t i = 0; i < rows; ++i)
+    {
+        for (std::size_t j = 0; j < cols; ++j)
         {
-            //incoming up
-            iUp = nodesToIndex(nodei, nodej, nodei - 1, nodej);
-            //incoming left
-            iLeft = nodesToIndex(nodei, nodej, nodei, nodej - 1);
-            //outgoing down
-            iDown = nodesToIndex(nodei, nodej, nodei + 1, nodej);
-            //outgoing right
-            iRight = nodesToIndex(nodei, nodej, nodei, nodej + 1);
-
-            if (x[iLeft] < 0)
-            {
-                outCurrents.push_back(iLeft);
-            }
-            if (x[iUp] < 0)
-            {
-                outCurrents.push_back(iUp);
-            }
-            if (x[iDown] > 0)
+            const std::size_t node = i * cols + j;
+            const std::size_t right = i * block + j, down = right + cols - 1;
+
+            NodeResistors &around = nodeResistorTable[node];
+            around.up = (i > 0) ? down - block : NoResistor;
+            around.left = (j > 0) ? right - 1 : NoResistor;
+            around.right = (j + 1 < cols) ? right : NoResistor;
+            around.down = (i + 1 < rows) ? down : NoResistor;
+
+            if (around.right != NoResistor)
             {
-                outCurrents.push_back(iDown);
+                resistorNodeTable[right].first = node;
+                resistorNodeTable[right].second = node + 1;
             }
-            if (x[iRight] > 0)
+            if (around.down != NoResistor)
             {
-                outCurrents.push_back(iRight);
+                resistorNodeTable[down].first = node;
+                resistorNodeTable[down].second = node + cols;
             }
-
-            //calculate maximun current
-            if (pastPtr == iRight)
-                iMax = calcCurrent(iDown, iLeft, iUp);
-            else if (pastPtr == iDown)
-                iMax = calcCurrent(iRight, iLeft, iUp);
-            else if (pastPtr == iLeft)
-                iMax = calcCurrent(iDown, iRight, iUp);
-            else if (pastPtr == iUp)
-                iMax = calcCurrent(iDown, iRight, iLeft);
-            else
-                // iMax = calcCurrent(iUp, iDown, iRight, iLeft);
-                iMax = maxCurrent(outCurrents);
         }
+    }
+}
 
-        //set the past pointer to the current path to be taken
-        pastPtr = iMax;
-        vectPath.push_back(nodePtr);
-        moveRes = indexToNodes(iMax);
-
-        if (iMax >= nodePtr)
-        {
-            nodePtr = calcNode(moveRes.row2, moveRes.col2);
-            // if (x[iMax] < 0)
-            // {
-            //     nodePtr = calcNode(moveRes.row1, moveRes.col1);
-            // }
-            // else
-            // {
-            //     nodePtr = calcNode(moveRes.row2, moveRes.col2);
-            // }
-        }
-        else
-        {
-            nodePtr = calcNode(moveRes.row1, moveRes.col1);
-            // if (x[iMax] < 0)
-            // {
-            //     nodePtr = calcNode(moveRes.row2, moveRes.col2);
-            // }
-            // else
-            // {
-            //     nodePtr = calcNode(moveRes.row1, moveRes.col1);
-            // }
-        }
-    } //end while
-
-    simplePath = vectPath;
-} // namespace anpi
-
-int ResistorGrid::calcNode(int row, int col)
+void ResistorGrid::discardNavigation()
 {
-    int cols = rawMap.cols();
-    int rows = rawMap.rows();
-    if (row >= rows || col > cols)
-        throw anpi::Exception("Resistor Grid: Calc Node: Node out of bounds");
-    return row * cols + col;
+    ++mapGeneration;
+    state.x.clear();
+    state.potentials.clear();
+    state.simplePath.clear();
+    state.smoothPath.clear();
+    state.fieldReady = false;
 }
 
-int ResistorGrid::calcCurrent(int up, int down, int right, int left)
-{
+/**
+ * Compute the value of the resitance given by the provided index
+ * 
+ * 
+ * 
+ **/
 
-    int iMax = up;
-    if (std::abs(x[iMax]) < std::abs(x[down]))
-    {
-        iMax = down;
-    }
-    if (std::abs(x[iMax]) < std::abs(x[right]))
-    {
-        iMax = right;
-    }
-    if (std::abs(x[iMax]) < std::abs(x[left]))
+double ResistorGrid::getResistanceValue(int indx)
+{
+    if ((indx < 0) || (size_t(indx) >= resistances.size()))
     {
-        iMax = left;
+        throw anpi::Exception("Resistor does not exist. Index exceeds the amount of resistors\n");
     }
-    return iMax;
+    return resistances[indx];
 }
 
-int ResistorGrid::calcCurrent(int down, int right, int left)
+/**
+ * The resistors of each row of nodes are stored together: first the
+ * cols-1 horizontal ones, which join each pixel with its right
+ * neighbour, and then the cols vertical ones, which join it with the
+ * pixel below.  The resistances of the pixels are looked up once per
+ * row, and both groups are computed from two contiguous rows of them.
+ */
+void ResistorGrid::computeResistances()
 {
+    const size_t cols = rawMap.cols(), rows = rawMap.rows();
+    const size_t count = (rows * cols == 0) ? 0 : rows * cols * 2 - (cols + rows);
 
-    int iMax = down;
-    if (std::abs(x[iMax]) < std::abs(x[right]))
-    {
-        iMax = right;
-    }
-    if (std::abs(x[iMax]) < std::abs(x[left]))
+    resistances.resize(count);
+    conductances.resize(count);
+    if (count == 0)
+        return;
+
+    const float *table = resistanceModel.levels().data();
+    std::vector<float> current(cols), next(cols), row(cols);
+    pixelResistances(rawMap[0], table, current.data(), cols);
+
+    double *res = resistances.data();
+    for (size_t i = 0; i < rows; ++i)
     {
-        iMax = left;
+        //horizontal
+        resistanceRow(current.data(), current.data() + 1, row.data(), cols - 1);
+        for (size_t j = 0; j + 1 < cols; ++j)
+            *res++ = row[j];
+
+        //vertical
+        if (i + 1 < rows)
+        {
+            pixelResistances(rawMap[i + 1], table, next.data(), cols);
+            resistanceRow(current.data(), next.data(), row.data(), cols);
+            for (size_t j = 0; j < cols; ++j)
+                *res++ = row[j];
+            current.swap(next);
+        }
     }
-    return iMax;
+
+    for (size_t r = 0; r < count; ++r)
+        conductances[r] = 1.0 / resistances[r];
 }
 
-int ResistorGrid::calcCurrent(int right, int left)
+/**
+∗ Compute a rute of more current and create a matrix for print.
+*
+* From each node the path follows the resistor with the largest current
+* leaving it.  The current flows from higher to lower potentials, so the
+* path cannot run in circles and ends at the end node.
+*/
+void ResistorGrid::calculateSimplePath(const indexPair &nodes)
 {
+    calculateSimplePath(nodes, state);
+}
+
+void ResistorGrid::calculateSimplePath(const indexPair &nodes, NavigationContext &context) const
+{
+    const std::size_t cols = rawMap.cols();
+    const std::size_t startNode = nodes.row1 * cols + nodes.col1;
+    const std::size_t endNode = nodes.row2 * cols + nodes.col2;
+
+    if ((startNode >= nodeResistorTable.size()) || (endNode >= nodeResistorTable.size()))
+        throw anpi::Exception("Start or End node out of bounds, node does not exist\n");
+    if (context.x.size() != resistorNodeTable.size())
+        throw anpi::Exception("ResistorGrid::calculateSimplePath(): no currents computed for this map");
+    if (context.mapGeneration != mapGeneration)
+        throw anpi::Exception("ResistorGrid::calculateSimplePath(): the currents belong to a previous map");
+
+    simplePathOf(context.x, startNode, endNode, context.simplePath);
+}
 
-    int iMax = right;
-    if (std::abs(x[iMax]) < std::abs(x[left]))
+std::size_t ResistorGrid::largestOutflow(const std::vector<double> &currents,
+                                         const std::size_t node) const
+{
+    //current leaving the node through each resistor: the node is the
+    //second end of the resistors up and left, and the first of the others
+    const NodeResistors &around = nodeResistors(node);
+    const std::size_t candidates[] = {around.up, around.left, around.right, around.down};
+    const double direction[] = {-1.0, -1.0, 1.0, 1.0};
+
+    std::size_t iMax = NoResistor;
+    double maxCurrent = 0.0;
+    for (int k = 0; k < 4; ++k)
     {
-        iMax = left;
+        if (candidates[k] == NoResistor)
+            continue;
+        const double current = direction[k] * currents[candidates[k]];
+        if (current > maxCurrent)
+        {
+            maxCurrent = current;
+            iMax = candidates[k];
+        }
     }
     return iMax;
 }
 
-int ResistorGrid::maxCurrent(std::vector<int> &currents)
+void ResistorGrid::simplePathOf(const std::vector<double> &currents,
+                                const std::size_t startNode, const std::size_t endNode,
+                                std::vector<int> &path) const
 {
-    int count = currents.size();
-    if (count == 0)
+    path.clear();
+    std::size_t nodePtr = startNode;
+    while (nodePtr != endNode)
     {
-        throw anpi::Exception("ResistorGrid::maxCurrent(): out currents vector is zero");
-    }
-    int max = currents[0];
-    double temp;
+        path.push_back(int(nodePtr));
+        if (path.size() > nodeResistorTable.size())
+            throw anpi::Exception("ResistorGrid::calculateSimplePath(): the currents do not lead to the end node");
 
-    for (int i = 1; i < count; ++i)
-    {
-        temp = x[i];
-        if (temp > x[max])
-            max = currents[i];
+        const std::size_t iMax = largestOutflow(currents, nodePtr);
+        if (iMax == NoResistor)
+            throw anpi::Exception("ResistorGrid::calculateSimplePath(): no current leaves the node");
+
+        //move to the other end of the resistor
+        const ResistorNodes &ends = resistorNodes(iMax);
+        nodePtr = ends.first + ends.second - nodePtr;
     }
-    return max;
 }
+
 /**
- *Para calcular el dezplasamiento de los datos se debe calcular el desplzamiento en X y el Desplazamiento en Y \
- *para esto se va revisando cada nodo y se guarda el dezplazamiento en en dos matrices una para x y una para Y. 
- * 
+ * The step length is controlled by step doubling: the difference
+ * between one step and two steps of half the length estimates the error
+ * of the position.  Steps with a larger error than the tolerance are
+ * repeated with a shorter length; after accepted steps the length grows
+ * according to the fifth-order error of RK4.  Where the field cannot be
+ * resolved even with the shortest step, or the steps stay so short that
+ * the path stalls, it continues one node along the largest current.
  */
-void ResistorGrid::calcDesplazamiento()
+void ResistorGrid::calculateSmoothPath(const indexPair &nodes)
 {
-    int iUp, iDown, iLeft, iRight;                 //Guarda las corrientes en cada punto
-    int nodei, nodej;                              //indexes for the node pointer
-    int nodePtr = 0;                               //Nodo puntero el cual verifica el punto en el que estoy
-    int nodeFInal = rawMap.cols() * rawMap.rows(); //Nodo final en donde se encuentra el
-    int cols = rawMap.cols();                      //Columnas totales
-    xDespla = rawMap;
-    yDespla = rawMap;
-    int i = 0;
-    int j = 0;
-
-    //Hay que buscar una forma para guardas los daros, para que no tengan que hacer todos los modulos
-    for (; nodePtr < nodeFInal; ++nodePtr)
-    {
-        nodei = nodePtr / cols;
-        nodej = nodePtr % cols;
-        //Para el caso de la primera fila
-        if (nodePtr <= cols - 1)
-        {
-            if (nodePtr == 0)
-            {
+    calculateSmoothPath(nodes, state);
+}
 
-                //outgoing down
-                iDown = nodesToIndex(nodei, nodej, nodei + 1, nodej);
-                //outgoing right
-                iRight = nodesToIndex(nodei, nodej, nodei, nodej + 1);
-                xDespla[i][j] = iRight;
-                yDespla[i][j] = iDown;
-            }
-            else if (nodePtr < cols - 1)
-            {
-                //incoming left
-                iLeft = nodesToIndex(nodei, nodej, nodei, nodej - 1);
-                //outgoing down
-                iDown = nodesToIndex(nodei, nodej, nodei + 1, nodej);
-                //outgoing right
-                iRight = nodesToIndex(nodei, nodej, nodei, nodej + 1);
-                xDespla[nodei][nodej] = iLeft + iRight;
-                yDespla[nodei][nodej] = iDown;
-            }
-            else
-            {
-                //incoming left
-                iLeft = nodesToIndex(nodei, nodej, nodei, nodej - 1);
-                //outgoing down
-                iDown = nodesToIndex(nodei, nodej, nodei + 1, nodej);
-                xDespla[nodei][nodej] = iLeft;
-                yDespla[nodei][nodej] = iDown;
-            }
+void ResistorGrid::calculateSmoothPath(const indexPair &nodes, NavigationContext &context) const
+{
+    const std::size_t cols = rawMap.cols();
+    const std::size_t startNode = nodes.row1 * cols + nodes.col1;
+    const std::size_t endNode = nodes.row2 * cols + nodes.col2;
+
+    if ((startNode >= nodeResistorTable.size()) || (endNode >= nodeResistorTable.size()))
+        throw anpi::Exception("Start or End node out of bounds, node does not exist\n");
+    if (startNode == endNode)
+        throw anpi::Exception("Start and End nodes are the same, no path to navigate\n");
+    if (context.x.size() != resistorNodeTable.size())
+        throw anpi::Exception("ResistorGrid::calculateSmoothPath(): no currents computed for this map");
+    if (context.mapGeneration != mapGeneration)
+        throw anpi::Exception("ResistorGrid::calculateSmoothPath(): the currents belong to a previous map");
+
+    if (!context.fieldReady)
+        calcDesplazamiento(context);
+
+    smoothPathOf(context.x, context.xDespla, context.yDespla, nodes, context.smoothPath);
+}
+
+void ResistorGrid::smoothPathOf(const std::vector<double> &currents,
+                                const Matrix<float> &dx, const Matrix<float> &dy,
+                                const indexPair &nodes, std::vector<PathPoint> &path) const
+{
+    const std::size_t cols = rawMap.cols(), rows = rawMap.rows();
+    const std::size_t endNode = nodes.row2 * cols + nodes.col2;
+
+    const StreamlineSettings &settings = streamlineSettings;
+    const FieldDirection field(dx, dy);
+    const PathPoint end = {double(nodes.row2), double(nodes.col2)};
+    PathPoint p = {double(nodes.row1), double(nodes.col1)};
+    path.assign(1, p);
+
+    //continue from the node nearest to p along its largest outgoing
+    //current, up to the next node; true if the path already left that
+    //node this way
+    std::vector<bool> crossed(rows * cols, false);
+    auto followCurrents = [&](const PathPoint &from) -> bool {
+        const std::size_t node = std::size_t(std::lround(from.row)) * cols + std::size_t(std::lround(from.col));
+        const PathPoint nearest = {double(node / cols), double(node % cols)};
+        if (node == endNode)
+        {
+            p = nearest;
+            return false;
         }
-        else if (j == 0)
+        if ((nearest.row != from.row) || (nearest.col != from.col))
+            path.push_back(nearest);
+        const std::size_t iMax = largestOutflow(currents, node);
+        if (iMax == NoResistor)
+            throw anpi::Exception("ResistorGrid::calculateSmoothPath(): no current leaves the node");
+        const ResistorNodes &ends = resistorNodes(iMax);
+        const std::size_t next = ends.first + ends.second - node;
+        p = {double(next / cols), double(next % cols)};
+        const bool again = crossed[node];
+        crossed[node] = true;
+        return again;
+    };
+
+    //the start node is a source, where the currents leaving it in opposite
+    //directions cancel out in the field: leave it along the largest one
+    followCurrents(p);
+    p.row = path.back().row + settings.initialStep * (p.row - path.back().row);
+    p.col = path.back().col + settings.initialStep * (p.col - path.back().col);
+    path.push_back(p);
+
+    const size_t maxSteps = (settings.maxSteps == 0u) ? 10u * rows * cols : settings.maxSteps;
+    double h = settings.initialStep;
+    double recentLength = 0.0;
+    std::size_t recentSteps = 0;
+    for (size_t step = 0;; ++step)
+    {
+        const double distance = std::hypot(end.row - p.row, end.col - p.col);
+        if (distance <= settings.arrivalRadius)
         {
-            if (nodePtr + cols == nodeFInal)
-            {
-                //incoming up
-                iUp = nodesToIndex(nodei, nodej, nodei - 1, nodej);
-                //outgoing right
-                iRight = nodesToIndex(nodei, nodej, nodei, nodej + 1);
-                xDespla[i][j] = iRight;
-                yDespla[i][j] = iUp;
-            }
+            //finish exactly at the end node
+            if (distance > settings.tolerance)
+                path.push_back(end);
             else
-            {
-                xDespla[i][j] = iRight;
-                yDespla[i][j] = iDown + iUp;
-            }
+                path.back() = end;
+            break;
         }
-        else if (j == cols - 1)
+        if (step == maxSteps)
+            throw anpi::Exception("ResistorGrid::calculateSmoothPath(): the path does not reach the end node");
+
+        //do not step past the end node
+        h = std::min(h, distance);
+
+        PathPoint full, half, twice;
+        if (!rk4Step(field, p, h, full) || !rk4Step(field, p, 0.5 * h, half) ||
+            !rk4Step(field, half, 0.5 * h, twice))
         {
-            if (nodePtr == nodeFInal - 1)
-            {
-                //incoming up
-                iUp = nodesToIndex(nodei, cols, nodei - 1, cols);
-                //incoming left
-                iLeft = nodesToIndex(nodei, cols, nodei, cols - 1);
-                xDespla[i][j] = iLeft;
-                yDespla[i][j] = iUp;
-            }
-            else
-            {
-                //incoming up
-                iUp = nodesToIndex(nodei, cols, nodei - 1, cols);
-                //incoming left
-                iLeft = nodesToIndex(nodei, cols, nodei, cols - 1);
-                //outgoing down
-                iDown = nodesToIndex(nodei, cols, nodei + 1, cols);
-                xDespla[i][j] = iLeft;
-                yDespla[i][j] = iUp + iDown;
-            }
+            throw anpi::Exception("ResistorGrid::calculateSmoothPath(): the current field vanishes");
         }
 
-        else if (nodePtr + cols > nodeFInal)
+        const double error = std::hypot(full.row - twice.row, full.col - twice.col);
+        const double factor = (error > 0.0) ? 0.9 * std::pow(settings.tolerance / error, 0.2) : 2.0;
+        if ((error > settings.tolerance) && (h > settings.minStep))
         {
-            //outgoing down
-            iUp = nodesToIndex(nodei, nodej, nodei - 1, nodej);
-            //outgoing right
-            iRight = nodesToIndex(nodei, nodej, nodei, nodej + 1);
-            //incoming left
-            iLeft = nodesToIndex(nodei, nodej, nodei, nodej - 1);
-            xDespla[i][j] = iLeft + iRight;
-            yDespla[i][j] = iUp;
+            h = std::max(settings.minStep, h * std::max(0.1, factor));
+            continue;
         }
 
-        else
+        //at the border of obstacles the direction of the field may turn
+        //abruptly, and the streamline crawls along that border or barely
+        //moves: cross such places along the currents between the nodes
+        recentLength += std::hypot(twice.row - p.row, twice.col - p.col);
+        if ((error > settings.tolerance) || ((++recentSteps == StallSteps) && (recentLength < 1.0)))
         {
-            //incoming up
-            iUp = nodesToIndex(nodei, nodej, nodei - 1, nodej);
-            //outgoing down
-            iDown = nodesToIndex(nodei, nodej, nodei + 1, nodej);
-            //outgoing right
-            iRight = nodesToIndex(nodei, nodej, nodei, nodej + 1);
-            //incoming left
-            iLeft = nodesToIndex(nodei, nodej, nodei, nodej - 1);
-            xDespla[i][j] = iLeft + iRight;
-            yDespla[i][j] = iDown + iUp;
+            //a stall at a node crossed before would repeat forever: the
+            //currents lead to the end node, follow them up to a new node
+            bool again;
+            do
+            {
+                again = followCurrents(p);
+                path.push_back(p);
+            } while (again);
+            h = settings.initialStep;
+            recentLength = 0.0;
+            recentSteps = 0;
+            continue;
         }
-        if (j == cols - 1 && nodePtr != 0)
+        if (recentSteps == StallSteps)
         {
-            ++i;
-            j = 0;
+            recentLength = 0.0;
+            recentSteps = 0;
+        }
+
+        //the path stays on the map
+        p.row = std::min(std::max(twice.row, 0.0), double(rows - 1));
+        p.col = std::min(std::max(twice.col, 0.0), double(cols - 1));
+        path.push_back(p);
+        h = std::min(settings.maxStep, h * std::min(2.0, factor));
+    }
+}
+
+int ResistorGrid::calcNode(int row, int col)
+{
+    int cols = rawMap.cols();
+    int rows = rawMap.rows();
+    if (row >= rows || col > cols)
+        throw anpi::Exception("Resistor Grid: Calc Node: Node out of bounds");
+    return row * cols + col;
+}
+
+void ResistorGrid::calcDesplazamiento()
+{
+    calcDesplazamiento(state);
+}
+
+void ResistorGrid::calcDesplazamiento(NavigationContext &context) const
+{
+    if (context.x.size() != resistorNodeTable.size())
+        throw anpi::Exception("ResistorGrid::calcDesplazamiento(): no currents computed for this map");
+    if (context.mapGeneration != mapGeneration)
+        throw anpi::Exception("ResistorGrid::calcDesplazamiento(): the currents belong to a previous map");
+
+    currentField(context.x, context.xDespla, context.yDespla);
+    context.fieldReady = true;
+}
+
+/**
+ * The currents of the horizontal resistors of a row of nodes are
+ * contiguous in the solution, followed by the ones of the vertical resistors to
+ * the next row, so that each row of both components is computed from
+ * a few contiguous arrays.  The interior of the rows is averaged with
+ * SIMD; only the first and last column and the first and last row,
+ * which have a single neighbour in a direction, are treated apart.
+ */
+void ResistorGrid::currentField(const std::vector<double> &currents,
+                                Matrix<float> &xField, Matrix<float> &yField) const
+{
+    const size_t cols = rawMap.cols(), rows = rawMap.rows();
+    xField.allocate(rows, cols);
+    yField.allocate(rows, cols);
+    if (rows * cols == 0)
+        return;
+
+    const size_t block = 2 * cols - 1;
+    const double *all = currents.data();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::ptrdiff_t ii = 0; ii < std::ptrdiff_t(rows); ++ii)
+    {
+        const size_t i = size_t(ii);
+        float *dx = xField[i];
+        float *dy = yField[i];
+
+        //horizontal component: the currents to the left and to the right
+        const double *horizontal = all + i * block;
+        if (cols == 1)
+        {
+            dx[0] = 0.0f;
         }
         else
         {
-            ++j;
+            dx[0] = float(horizontal[0]);
+            meanCurrentRow(horizontal, horizontal + 1, dx + 1, cols - 2);
+            dx[cols - 1] = float(horizontal[cols - 2]);
         }
+
+        //vertical component: the currents from above and to below
+        const double *up = (i > 0) ? all + (i - 1) * block + (cols - 1) : nullptr;
+        const double *down = (i + 1 < rows) ? all + i * block + (cols - 1) : nullptr;
+        if ((up != nullptr) && (down != nullptr))
+            meanCurrentRow(up, down, dy, cols);
+        else if (up != nullptr)
+            currentRow(up, dy, cols);
+        else if (down != nullptr)
+            currentRow(down, dy, cols);
+        else
+            std::fill(dy, dy + cols, 0.0f);
     }
 }
 
@@ -1,3 +1,4 @@
+#include <cassert>
 #include <cstdlib>
 #include <iostream>
 
@@ -6,12 +7,19 @@
 #include "Solver.hpp"
 
 #include "MatrixUtils.hpp"
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include <opencv2/core.hpp>    // For cv::Mat
 #include <opencv2/highgui.hpp> // For cv::imread/imshow
 
 #include <Matrix.hpp>
+#include <SparseMatrix.hpp>
+#include <ConjugateGradient.hpp>
+#include <Multigrid.hpp>
+#include <SparseCholesky.hpp>
+#include <ArenaAllocator.hpp>
 #include <Exception.hpp>
 
 namespace anpi
@@ -22,6 +30,234 @@ const int OHM = 1;
 const int BLACK = 0;
 const int WHITE = 1;
 
+/**
+ * Methods available to solve the circuit of the grid.  NodalMultigrid
+ * is the default: its cost grows linearly with the number of nodes N,
+ * while the iterations of the conjugate gradient grow like sqrt(N).
+ */
+enum SolverMethod
+{
+    /// Node and mesh equations, one unknown per resistor, with sparse LU
+    MeshSparseLU,
+    /**
+     * Nodal analysis, one unknown per node, with preconditioned CG.  Its
+     * cost grows roughly like N^1.5, so use NodalMultigrid for large maps.
+     */
+    NodalConjugateGradient,
+    /// Nodal analysis, one unknown per node, with geometric multigrid
+    NodalMultigrid,
+    /**
+     * Nodal analysis, one unknown per node, with sparse Cholesky.  The
+     * factor has about rows*cols^2 entries, limited to
+     * ResistorGrid::CholeskyMaxEntries (maps up to about 500x500).
+     */
+    NodalCholesky
+};
+
+/**
+ * Resistance of the binary maps: black pixels block the way, all others
+ * conduct equally well
+ */
+struct BinaryResistance
+{
+    inline double operator()(const float intensity) const
+    {
+        return (intensity == BLACK) ? MEGAOHM : OHM;
+    }
+};
+
+/**
+ * Conductance growing linearly with the intensity of the pixel, from
+ * the one of a black pixel to the one of a white pixel.  Darker pixels
+ * can represent rough terrain, which the current avoids if possible.
+ */
+struct LinearConductance
+{
+    /// Resistance of black and white pixels
+    LinearConductance(const double black = MEGAOHM, const double white = OHM)
+        : blackConductance(1.0 / black), whiteConductance(1.0 / white) {}
+
+    inline double operator()(const float intensity) const
+    {
+        return 1.0 / (blackConductance +
+                      intensity * (whiteConductance - blackConductance));
+    }
+
+    double blackConductance;
+    double whiteConductance;
+};
+
+/**
+ * Mapping of the intensity of the pixels of a map to resistances.
+ *
+ * The model is given by a policy, a functor computing the resistance
+ * of a pixel from its intensity in [0,1], like BinaryResistance or
+ * LinearConductance.  It is evaluated at construction for each of the
+ * Levels intensities of an 8 bit image, and the map is then converted
+ * with lookups in that table, so that the cost of building the grid does
+ * not depend on the model.
+ *
+ * A resistor between two pixels takes the larger resistance of both,
+ * i.e. it is as hard to traverse as its worst end.
+ */
+class ResistanceModel
+{
+  public:
+    /// Number of intensities distinguished
+    static const size_t Levels = 256;
+
+    /// Binary model, as in the original maps
+    ResistanceModel() : ResistanceModel(BinaryResistance()) {}
+
+    /// Model given by the policy
+    template <class Policy>
+    explicit ResistanceModel(const Policy &policy) : table(Levels)
+    {
+        for (size_t l = 0; l < Levels; ++l)
+        {
+            table[l] = float(policy(float(l) / float(Levels - 1)));
+        }
+    }
+
+    /// Level of the table used for the given intensity
+    static inline size_t level(const float intensity)
+    {
+        const float v = std::min(std::max(intensity, 0.0f), 1.0f);
+        return size_t(v * float(Levels - 1) + 0.5f);
+    }
+
+    /// Resistance of a pixel with the given intensity
+    inline float resistance(const float intensity) const
+    {
+        return table[level(intensity)];
+    }
+
+    /// Resistances of all levels
+    inline const std::vector<float> &levels() const
+    {
+        return table;
+    }
+
+  private:
+    std::vector<float> table;
+};
+
+/// Entry of the index tables for the resistors beyond the border of the map
+const std::size_t NoResistor = std::size_t(-1);
+
+/**
+ * Resistors joining a node with its four neighbours, or NoResistor on
+ * the sides where the node lies on the border of the map
+ */
+struct NodeResistors
+{
+    std::size_t up;
+    std::size_t down;
+    std::size_t left;
+    std::size_t right;
+};
+
+/// Numbers (row * cols + col) of the two nodes joined by a resistor
+struct ResistorNodes
+{
+    /// Upper or left node
+    std::size_t first;
+    /// Lower or right node
+    std::size_t second;
+};
+
+/// Point of a smooth path, with fractional row and column of the grid
+struct PathPoint
+{
+    double row;
+    double col;
+};
+
+/**
+ * Settings for the integration of smooth paths through the current
+ * field.  All lengths are measured in nodes.
+ */
+struct StreamlineSettings
+{
+    inline StreamlineSettings(const double tol = 1.0e-3,
+                              const double initial = 0.5,
+                              const double minimum = 1.0e-3,
+                              const double maximum = 1.0,
+                              const double radius = 0.5,
+                              const size_t steps = 0u)
+        : tolerance(tol), initialStep(initial), minStep(minimum),
+          maxStep(maximum), arrivalRadius(radius), maxSteps(steps){};
+
+    /// Largest position error accepted in each step
+    double tolerance;
+
+    /// Length of the first step, leaving the start node
+    double initialStep;
+
+    /// Shortest step, accepted even if its error is larger
+    double minStep;
+
+    /// Longest step
+    double maxStep;
+
+    /// The path ends when it gets this close to the end node
+    double arrivalRadius;
+
+    /// Maximum number of steps (zero means ten times the number of nodes)
+    size_t maxSteps;
+};
+
+/// Paths found for one query of ResistorGrid::navigateBatch()
+struct NavigationResult
+{
+    /// Nodes following the largest currents, as calculateSimplePath()
+    std::vector<int> simplePath;
+    /// Path through the current field, as calculateSmoothPath(), if requested
+    std::vector<PathPoint> smoothPath;
+};
+
+/**
+ * Data of the navigations of one client of a ResistorGrid: the system
+ * and currents of its last query and the paths computed from them.
+ * Contexts cannot be copied, as each one owns the memory region of its
+ * temporaries.
+ *
+ * The grid itself keeps only the data of the map and of the prepared
+ * nodal system, which do not change while navigating.  Many threads
+ * can therefore navigate on the same grid at the same time, each one
+ * with its own context.
+ */
+struct NavigationContext
+{
+    ///  Mesh system, if solved with MeshSparseLU
+    SparseMatrix<double> A;
+    ///  Right hand side of the last system
+    std::vector<double> b;
+    ///  Currents of all resistors
+    std::vector<double> x;
+    ///  Potentials of the nodes computed by the nodal analysis
+    std::vector<double> potentials;
+    ///  Nodes of the simple path
+    std::vector<int> simplePath;
+    ///  Points of the smooth path through the current field
+    std::vector<PathPoint> smoothPath;
+    /// Matriz de dezplazamiento X: current to the right at each node
+    Matrix<float> xDespla;
+    /// Matriz de dezplazamiento Y: current downwards at each node
+    Matrix<float> yDespla;
+    ///  True if xDespla and yDespla hold the field of the current x
+    bool fieldReady = false;
+    ///  Generation of the map of the grid the last query was navigated on
+    std::size_t mapGeneration = 0;
+    ///  Vectors of the multigrid cycles, the hierarchy is shared by the grid
+    Multigrid<double>::Workspace multigridWorkspace;
+    /**
+     * Region for the temporaries of the solvers during each navigation,
+     * which grows to the needs of the map in the first ones
+     */
+    Arena arena;
+};
+
 /// Pack a  pair  of  indices  of  the  nodes  of  a  resistor
 struct indexPair
 {
@@ -50,24 +286,161 @@ struct indexPair
 class ResistorGrid
 {
   private:
-    ///  Matrix  of  the  current  equation  system
-    Matrix<double> A;
-    ///  Vector  of  the  current  equation  system
-    std::vector<double> b;
-    ///  Vector  of solutions for the  current  equation  system
-    std::vector<double> x;
+    ///  Sparse matrix  of  the  nodal  equation  system
+    SparseMatrix<double> A;
     /// Raw map data
     Matrix<float> rawMap;
-    ///  Vector  with the nodes to follow simple path
-    std::vector<int> simplePath;
+    ///  Resistance of each resistor, in the order of nodesToIndex()
+    std::vector<double> resistances;
+    ///  Conductance (inverse resistance) of each resistor
+    std::vector<double> conductances;
+    ///  Model giving the resistance of each pixel
+    ResistanceModel resistanceModel;
+    ///  Resistors around each node, indexed by node number
+    std::vector<NodeResistors> nodeResistorTable;
+    ///  Nodes joined by each resistor
+    std::vector<ResistorNodes> resistorNodeTable;
+    ///  Settings for the integration of the smooth path
+    StreamlineSettings streamlineSettings;
 
-    /// Matriz de dezplazamiento X
-    Matrix<float> xDespla;
+    ///  Context of the navigations through the non-const interface
+    NavigationContext state;
 
-    /// Matriz de dezplazamiento Y
-    Matrix<float> yDespla;
+    /**
+     * Number of changes of the map or of its resistances.  navigate()
+     * stamps it into the context, so that the currents of a context
+     * navigated on a previous map of the same size are rejected.
+     */
+    std::size_t mapGeneration = 0;
+
+    ///  Method used to solve the equation system
+    SolverMethod solverMethod = NodalMultigrid;
+
+    ///  Settings for the conjugate gradient solver
+    CGSettings<double> cgSettings;
+
+    ///  Preconditioner of the nodal matrix for the conjugate gradient
+    CGPreconditioner<double> cgPreconditioner;
+
+    ///  Settings for the multigrid solver
+    MultigridSettings<double> mgSettings;
+
+    ///  Nodal matrix of the current map, as grid operator
+    GridOperator<double> laplacian;
+
+    ///  Multigrid hierarchy of the nodal matrix
+    Multigrid<double> multigrid;
+
+    ///  Cholesky factorization of the nodal matrix
+    SparseCholesky<double> cholesky;
+
+    ///  True if the nodal system has been prepared for the current map
+    bool nodalReady = false;
+
+    ///  Solver method the nodal system was prepared for
+    SolverMethod nodalMethod = NodalMultigrid;
+
+    ///  Directory of the cache of factorizations, or empty if disabled
+    std::string cacheDirectory;
+
+    /**
+     * Assemble the nodal matrix of the current map and prepare the
+     * selected solver for it (multigrid hierarchy, factorization or
+     * preconditioner).
+     * This depends only on the map, so that all navigations on the same
+     * map share it.
+     */
+    void prepareNodal();
+
+    /**
+     * Compute the resistance and conductance of all resistors of the
+     * current raw map.  Called whenever the map changes, so that the
+     * assembly of the systems only reads these tables.
+     */
+    void computeResistances();
+
+    /**
+     * Build the tables relating nodes and resistors for the size of the
+     * current raw map, so that traversals of the grid need neither
+     * divisions nor border checks to find their neighbours.
+     */
+    void computeIndexTables();
+
+    /**
+     * Forget the currents and paths of the last navigation of the grid,
+     * which belong to the previous map or resistances, and start a new
+     * generation of the map
+     */
+    void discardNavigation();
+
+    /**
+     * Name of the file caching the factorization of the current map,
+     * derived from a hash of its pixels and the solver method
+     */
+    std::string cacheFile() const;
+
+    /**
+     * Load the Cholesky factorization of the current map from the
+     * cache, if there is one
+     *
+     * @param nodal nodal matrix of the current map, whose profile the
+     *        cached factor must have
+     * @return true if the factorization was loaded
+     */
+    bool loadCachedFactorization(const SparseMatrix<double> &nodal);
+
+    /// Store the Cholesky factorization of the current map in the cache
+    void storeCachedFactorization() const;
+
+    /**
+     * Solve the grid with nodal analysis, leaving the currents of the
+     * resistors in x
+     */
+    bool navigateNodal(const int startNode, const int endNode,
+                       NavigationContext &context) const;
+
+    /// Number of queries of navigateBatch() solved together
+    static const std::size_t BatchBlock = 32;
+
+    /// Currents of all resistors for the given potentials of the nodes
+    void currentsFromPotentials(const std::vector<double> &pot,
+                                std::vector<double> &currents) const;
+
+    /**
+     * Resistor with the largest current leaving the node, or NoResistor
+     * if no current leaves it
+     */
+    std::size_t largestOutflow(const std::vector<double> &currents,
+                               const std::size_t node) const;
+
+    /// Path of the largest currents, see calculateSimplePath()
+    void simplePathOf(const std::vector<double> &currents,
+                      const std::size_t startNode, const std::size_t endNode,
+                      std::vector<int> &path) const;
+
+    /// Field of the given currents, see calcDesplazamiento()
+    void currentField(const std::vector<double> &currents,
+                      Matrix<float> &xField, Matrix<float> &yField) const;
+
+    /**
+     * Accepted steps of the streamline that must advance at least the
+     * distance between two nodes, otherwise the path continues along the
+     * currents
+     */
+    static const std::size_t StallSteps = 16;
+
+    /// Path through the field of the currents, see calculateSmoothPath()
+    void smoothPathOf(const std::vector<double> &currents,
+                      const Matrix<float> &dx, const Matrix<float> &dy,
+                      const indexPair &nodes, std::vector<PathPoint> &path) const;
 
   public:
+    /**
+     * Largest number of entries of the Cholesky factor of the nodal
+     * matrix (1 GiB), beyond which NodalCholesky rejects the map
+     */
+    static const std::size_t CholeskyMaxEntries = std::size_t(1) << 27;
+
     ///  . . .  constructors  and  other  methods
 
     // inline void initializeForTesting(int x, int y)
@@ -79,34 +452,105 @@ class ResistorGrid
     // }
 
     //getters and setters
-    inline void setA(Matrix<double> a)
-    {
-        A = a;
-    }
     inline void setRawMap(Matrix<float> a)
     {
         rawMap = Matrix<float>(a);
+        computeIndexTables();
+        computeResistances();
+        nodalReady = false;
+    }
+    /**
+     * Change the mapping of the pixels to resistances, e.g.
+     * setResistanceModel(ResistanceModel(LinearConductance()))
+     */
+    inline void setResistanceModel(const ResistanceModel &model)
+    {
+        resistanceModel = model;
+        computeResistances();
+        discardNavigation();
+        nodalReady = false;
+    }
+    inline const ResistanceModel &getResistanceModel() const
+    {
+        return resistanceModel;
+    }
+    inline void setSolverMethod(const SolverMethod method)
+    {
+        solverMethod = method;
+    }
+    inline void setCGSettings(const CGSettings<double> &settings)
+    {
+        if (settings.preconditioner != cgSettings.preconditioner)
+            nodalReady = false;
+        cgSettings = settings;
+    }
+    inline void setMultigridSettings(const MultigridSettings<double> &settings)
+    {
+        mgSettings = settings;
+        nodalReady = false;
+    }
+    /**
+     * Keep the factorizations of the maps in the given directory, so
+     * that a later process navigating the same map does not need to
+     * compute them again.  Currently used by NodalCholesky, i.e. only
+     * for maps below CholeskyMaxEntries.  An empty name disables the
+     * cache.
+     */
+    inline void setCacheDirectory(const std::string &dir)
+    {
+        cacheDirectory = dir;
+    }
+    inline const std::string &getCacheDirectory() const
+    {
+        return cacheDirectory;
     }
-    inline Matrix<double> getA()
+    inline const std::vector<double> &getX() const
     {
-        return A;
+        return state.x;
+    }
+    inline void setStreamlineSettings(const StreamlineSettings &settings)
+    {
+        streamlineSettings = settings;
+    }
+    inline const std::vector<int> &getSimplePath() const
+    {
+        return state.simplePath;
+    }
+    inline const std::vector<PathPoint> &getSmoothPath() const
+    {
+        return state.smoothPath;
+    }
+    inline const Matrix<float> &getXDespla() const
+    {
+        return state.xDespla;
+    }
+    inline const Matrix<float> &getYDespla() const
+    {
+        return state.yDespla;
+    }
+    /// Matrix of the last system solved by navigate()
+    inline SparseMatrix<double> getA()
+    {
+        return (solverMethod == MeshSparseLU) ? state.A : A;
     }
 
     inline void printA()
     {
-        anpi::printMatrix(A);
+        Matrix<double> dense;
+        getA().toDense(dense);
+        anpi::printMatrix(dense);
         std::cout << std::endl;
     }
 
     inline void printDesX()
     {
-        anpi::printMatrix(xDespla);
+        anpi::printMatrix(state.xDespla);
         std::cout << std::endl;
     }
 
     inline void printDesY()
     {
-        anpi::printMatrix(yDespla);
+        anpi::printMatrix(state.yDespla);
         std::cout << std::endl;
     }
 
@@ -119,18 +563,18 @@ class ResistorGrid
     inline void printB()
     {
         std::cout << " \n b vector is: \n";
-        for (size_t i = 0; i < b.size(); ++i)
+        for (size_t i = 0; i < state.b.size(); ++i)
         {
-            std::cout << b[i] << "  ";
+            std::cout << state.b[i] << "  ";
         }
         std::cout << std::endl;
     }
     inline void printX()
     {
         std::cout << " \n x vector is: \n";
-        for (size_t i = 0; i < x.size(); ++i)
+        for (size_t i = 0; i < state.x.size(); ++i)
         {
-            std::cout << x[i] << "  ";
+            std::cout << state.x[i] << "  ";
         }
         std::cout << std::endl;
     }
@@ -138,9 +582,9 @@ class ResistorGrid
     inline void printSimplePath()
     {
         std::cout << " \n Simple Path is: \n";
-        for (size_t i = 0; i < simplePath.size(); ++i)
+        for (size_t i = 0; i < state.simplePath.size(); ++i)
         {
-            std::cout << simplePath[i] << "  ";
+            std::cout << state.simplePath[i] << "  ";
         }
         std::cout << std::endl;
     }
@@ -155,23 +599,84 @@ class ResistorGrid
 */
     bool navigate(const indexPair &nodes);
 
+    /**
+     * Prepare the current map for the selected solver method, i.e. the
+     * nodal system and its factorization, multigrid hierarchy or
+     * preconditioner.  This
+     * is done by navigate() when needed, but must be called before the
+     * const navigate() is used.
+     */
+    void prepare();
+
+    /**
+     * Navigate between the given nodes, leaving the system, currents and
+     * paths in the given context instead of in the grid.
+     *
+     * The grid is not modified, so that several threads can call this
+     * at the same time with different contexts, as long as nobody
+     * changes the map or the settings meanwhile.  A context can be
+     * reused for any number of navigations of the same thread.
+     *
+     * @throws anpi::Exception if the nodal system has not been prepared
+     */
+    bool navigate(const indexPair &nodes, NavigationContext &context) const;
+
+    /**
+     * Navigate between the nodes of many queries on the current map.
+     *
+     * This gives the same paths as navigate() followed by
+     * calculateSimplePath() and, if smooth is true, calculateSmoothPath()
+     * for each query, but the preparation of the system is shared and
+     * the queries are solved and traced together.  The currents and
+     * paths stored for single navigations are not changed.
+     *
+     * @throws anpi::Exception if a query is invalid or has no path
+     */
+    std::vector<NavigationResult> navigateBatch(const std::vector<indexPair> &queries,
+                                                const bool smooth = false);
+
     /**
 ∗ compute a number representig the resistor  located in the provided indices
+*
+* @throws anpi::Exception if the nodes are not neighbours in the map
 */
-    std::size_t nodesToIndex(const std::size_t row1, const std::size_t col1, const std::size_t row2, const std::size_t col2);
+    std::size_t nodesToIndex(const std::size_t row1, const std::size_t col1, const std::size_t row2, const std::size_t col2) const;
 
     /**
 ∗ compute a number representig the resistor  located in the provided indices
 */
-    inline std::size_t nodesToIndex(const indexPair idx)
+    inline std::size_t nodesToIndex(const indexPair idx) const
     {
         return nodesToIndex(idx.row1, idx.col1, idx.row2, idx.col2);
     }
 
     /**
 ∗ compute the indices of the resistor given the numerical representation of it
+*
+* @throws anpi::Exception if the resistor does not exist
 */
-    indexPair indexToNodes(const std::size_t idx);
+    indexPair indexToNodes(const std::size_t idx) const;
+
+    /**
+     * Resistors around the node row * cols + col, without bounds checks.
+     * This is meant for the inner loops traversing the grid; the checked
+     * alternative is nodesToIndex().
+     */
+    inline const NodeResistors &nodeResistors(const std::size_t node) const
+    {
+        assert(node < nodeResistorTable.size());
+        return nodeResistorTable[node];
+    }
+
+    /**
+     * Nodes joined by the given resistor, without bounds checks.  The
+     * checked alternative is indexToNodes().
+     */
+    inline const ResistorNodes &resistorNodes(const std::size_t idx) const
+    {
+        assert(idx < resistorNodeTable.size());
+        return resistorNodeTable[idx];
+    }
 
     /**
  * Compute the vale of the resitance given by the provided index
@@ -180,27 +685,57 @@ class ResistorGrid
  * 
  **/
 
-    int getResistanceValue(int indx);
+    double getResistanceValue(int indx);
 
     /**
     ∗ Compute a rute of more current and create a matrix for print.
     */
     void calculateSimplePath(const indexPair &nodes);
 
+    /**
+     * Simple path of the last navigation of the context
+     *
+     * @throws anpi::Exception if the map or the resistances of the grid
+     *         changed since that navigation
+     */
+    void calculateSimplePath(const indexPair &nodes, NavigationContext &context) const;
+
     /**
     ∗ Calculate a node in matrix.
     */
     int calcNode(int row, int col);
 
     /**
-    ∗ Calculate more current number.
-    */
-    int calcCurrent(int Up, int Dowm, int Right, int Left);
-    int calcCurrent(int down, int right, int left);
-    int calcCurrent(int right, int left);
+     * Compute a smooth path from the start to the end node following
+     * the current field of the last navigation between them.
+     *
+     * The field of calcDesplazamiento() is interpolated bilinearly
+     * between the nodes, and its streamline integrated with RK4 steps
+     * whose length adapts to the curvature of the path, as given by
+     * the streamline settings.  The points are stored in smoothPath,
+     * from the start to the end node.  The system is not solved again.
+     */
+    void calculateSmoothPath(const indexPair &nodes);
+
+    /**
+     * Smooth path of the last navigation of the context
+     *
+     * @throws anpi::Exception if the map or the resistances of the grid
+     *         changed since that navigation
+     */
+    void calculateSmoothPath(const indexPair &nodes, NavigationContext &context) const;
 
-    int maxCurrent(std::vector<int> &currents);
+    /**
+     * Compute the field of the currents of the last navigation: for each
+     * node the mean current through its horizontal resistors, to the
+     * right, in xDespla, and through its vertical ones, downwards, in
+     * yDespla.  Nodes on the border use their single resistor in that
+     * direction.
+     */
     void calcDesplazamiento();
+
+    /// Current field of the last navigation of the context
+    void calcDesplazamiento(NavigationContext &context) const;
 };
 
 } // namespace anpi
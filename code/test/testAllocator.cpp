@@ -10,6 +10,13 @@
 
 #include <boost/test/unit_test.hpp>
 #include <Allocator.hpp>
+#include <ArenaAllocator.hpp>
+#include <HugePageAllocator.hpp>
+#include <MappedFileAllocator.hpp>
+#include <Solver.hpp>
+
+#include <cmath>
+#include <Matrix.hpp>
 
 #define COMMA ,
 
@@ -72,4 +79,182 @@ BOOST_AUTO_TEST_CASE( Checks ) {
   
 }
 
+BOOST_AUTO_TEST_CASE( Arena ) {
+
+  anpi::Arena arena(4096);
+
+  {
+    typedef anpi::arena_allocator<float,32> alloc_type;
+    alloc_type alloc(arena);
+    float* a = alloc.allocate(3);
+    float* b = alloc.allocate(5);
+
+    BOOST_CHECK( reinterpret_cast<size_t>(a) % 32 == 0);
+    BOOST_CHECK( reinterpret_cast<size_t>(b) % 32 == 0);
+    BOOST_CHECK( b == a + 8 );
+
+    // the last allocation is given back immediately
+    alloc.deallocate(b,5);
+    BOOST_CHECK( alloc.allocate(5) == b );
+    BOOST_CHECK( arena.used() == (8 + 5)*sizeof(float) );
+
+    // too large for the region: taken from the heap
+    double* c = anpi::arena_allocator<double,64>(arena).allocate(1024);
+    BOOST_CHECK( reinterpret_cast<size_t>(c) % 64 == 0);
+    BOOST_CHECK( arena.overflowed() );
+
+    // reset grows the region to fit everything
+    arena.reset();
+    BOOST_CHECK( arena.used() == 0 );
+    BOOST_CHECK( !arena.overflowed() );
+    BOOST_CHECK( arena.capacity() >= 64 + 1024*sizeof(double) );
+  }
+
+  {
+    typedef anpi::arena_row_allocator<float> alloc_type;
+    typedef anpi::Matrix<float,alloc_type> matrix_type;
+
+    BOOST_CHECK( anpi::is_aligned_alloc<alloc_type>::value );
+    typedef anpi::extract_alignment<anpi::arena_row_allocator<int,32> > ext;
+    BOOST_CHECK(ext::value==32);
+    BOOST_CHECK(ext::aligned == true );
+    BOOST_CHECK(ext::row_aligned == true );
+
+    {
+      anpi::Arena::Scope scope(arena);
+      matrix_type a = {{1,2,3},{4,5,6}};
+      matrix_type b = {{7,8},{9,10},{11,12}};
+      matrix_type c = a*b;
+      matrix_type d = c + c;
+
+      BOOST_CHECK( d == matrix_type({{116,128},{278,308}}) );
+      BOOST_CHECK( arena.used() > 0 );
+      BOOST_CHECK( !arena.overflowed() );
+    }
+    BOOST_CHECK( arena.used() == 0 );
+    BOOST_CHECK( anpi::Arena::current() == nullptr );
+
+    // without a current arena the memory comes from the heap
+    matrix_type e(7,9,1.f);
+    BOOST_CHECK( reinterpret_cast<size_t>(e.data()) %
+                 anpi::DefaultAlignment == 0);
+
+    // a heap matrix keeps its memory when assigned temporaries of the
+    // arena, and its allocator when swapped or assigned an alias
+    matrix_type m(4,4,1.f);
+    matrix_type s(2,2,3.f);
+    {
+      anpi::Arena::Scope scope(arena);
+      matrix_type a(4,4,1.f);
+      m = a * a;
+      BOOST_CHECK( m == matrix_type(4,4,4.f) );
+
+      matrix_type t(3,3,2.f);
+      s.swap(t);
+      BOOST_CHECK( t == matrix_type(2,2,3.f) );
+    }
+    BOOST_CHECK( arena.used() == 0 );
+    BOOST_CHECK( m == matrix_type(4,4,4.f) );
+    BOOST_CHECK( s == matrix_type(3,3,2.f) );
+    BOOST_CHECK( s.rows() == 3 && s.cols() == 3 );
+
+    m = m.block(1,1,2,2);
+    BOOST_CHECK( m == matrix_type(2,2,4.f) );
+  }
+}
+
+BOOST_AUTO_TEST_CASE( HugePages ) {
+
+  {
+    typedef anpi::huge_page_allocator<double,64> alloc_type;
+    alloc_type alloc;
+
+    // small blocks come from the heap
+    double* small = alloc.allocate(100);
+    BOOST_CHECK( reinterpret_cast<size_t>(small) % 64 == 0);
+    alloc.deallocate(small,100);
+
+    // large blocks are aligned to the huge pages
+    const size_t n = anpi::HugePageSize/sizeof(double) + 17;
+    double* large = alloc.allocate(n);
+    BOOST_CHECK( reinterpret_cast<size_t>(large) % anpi::HugePageSize == 0);
+    large[0] = 1.0;
+    large[n-1] = 2.0;
+    alloc.deallocate(large,n);
+  }
+
+  {
+    typedef anpi::huge_page_row_allocator<float> alloc_type;
+    typedef anpi::Matrix<float,alloc_type> matrix_type;
+
+    BOOST_CHECK( anpi::is_aligned_alloc<alloc_type>::value );
+    typedef anpi::extract_alignment<anpi::huge_page_row_allocator<int,32> > ext;
+    BOOST_CHECK(ext::value==32);
+    BOOST_CHECK(ext::aligned == true );
+    BOOST_CHECK(ext::row_aligned == true );
+
+    const alloc_type alloc(anpi::FirstTouchPlacement);
+    matrix_type a(1030,1030,1.f,alloc);
+    BOOST_CHECK( reinterpret_cast<size_t>(a.data()) % anpi::HugePageSize == 0);
+
+    matrix_type b = a + a;
+    BOOST_CHECK( b(1029,1029) == 2.f );
+    BOOST_CHECK( b(0,517) == 2.f );
+  }
+}
+
+BOOST_AUTO_TEST_CASE( MappedFile ) {
+
+  typedef anpi::mapped_file_row_allocator<double> alloc_type;
+  typedef anpi::Matrix<double,alloc_type> matrix_type;
+
+  BOOST_CHECK( anpi::is_aligned_alloc<alloc_type>::value );
+  typedef anpi::extract_alignment<anpi::mapped_file_row_allocator<int,32> > ext;
+  BOOST_CHECK(ext::value==32);
+  BOOST_CHECK(ext::aligned == true );
+  BOOST_CHECK(ext::row_aligned == true );
+
+  // diagonally dominant system stored in a file
+  const size_t n = 67;
+  matrix_type A(n,n,anpi::DoNotInitialize,alloc_type());
+  BOOST_CHECK( reinterpret_cast<size_t>(A.data()) % anpi::DefaultAlignment == 0);
+  BOOST_CHECK( A.dcols() >= n );
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      A(i,j) = (i == j) ? double(2*n) : double((i*3 + j*5) % 7) - 3.0;
+    }
+  }
+
+  matrix_type B = A + A;
+  BOOST_CHECK( B(n-1,n-2) == 2.0*A(n-1,n-2) );
+
+  // the numerical code works on views of the mapped matrix, and
+  // factors into mapped storage
+  anpi::LUWorkspace<double,alloc_type> ws;
+  anpi::lu(A.view(),ws);
+  BOOST_CHECK( reinterpret_cast<size_t>(ws.LU.data()) % 4096 == 0 );
+
+  anpi::LUWorkspace<double> heap;
+  anpi::lu(A.view(),heap);
+  BOOST_CHECK( ws.permut == heap.permut );
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      BOOST_CHECK( ws.LU(i,j) == heap.LU(i,j) );
+    }
+  }
+
+  const std::vector<double> b(n,1.0);
+  std::vector<double> x;
+  anpi::luSolve(ws.LU,ws.permut,b,x);
+
+  std::vector<double> Ax(n,0.0);
+  anpi::multiplyAdd(1.0,A.view(),x,0.0,Ax);
+  for (size_t i = 0; i < n; ++i) {
+    BOOST_CHECK( std::abs(Ax[i] - b[i]) < 1e-10 );
+  }
+
+  BOOST_CHECK_THROW( alloc_type("/nonexistent/anpi").allocate(16),
+                     std::bad_alloc );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,192 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, TEC, Costa Rica
+ *
+ * This file is part of the CE3102 Numerical Analysis lecture at TEC
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "ConjugateGradient.hpp"
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+
+#include <cmath>
+
+namespace anpi
+{
+namespace test
+{
+
+/// Build the Laplacian of a n x n grid with one grounded corner
+template <typename T>
+void gridLaplacian(const size_t n, SparseMatrix<T> &A)
+{
+  const size_t nodes = n * n;
+  A.allocate(nodes, nodes, 5 * nodes);
+  for (size_t k = 0; k < nodes; ++k)
+  {
+    const size_t i = k / n, j = k % n;
+    if (k == 0)
+    {
+      A.insert(k, k, T(1));
+      continue;
+    }
+    T diag = T(0);
+    // the conductance alternates to avoid a trivially uniform grid
+    const T g = (i % 2 == 0) ? T(1) : T(0.01);
+    if (i > 0)
+    {
+      diag += T(1);
+      if (k - n != 0)
+        A.insert(k, k - n, T(-1));
+    }
+    if (j > 0)
+    {
+      diag += g;
+      if (k - 1 != 0)
+        A.insert(k, k - 1, -g);
+    }
+    if (j < n - 1)
+    {
+      diag += g;
+      A.insert(k, k + 1, -g);
+    }
+    if (i < n - 1)
+    {
+      diag += T(1);
+      A.insert(k, k + n, T(-1));
+    }
+    A.insert(k, k, diag);
+  }
+  A.finalize();
+}
+
+/// Solve a grid system with all preconditioners
+template <typename T>
+void cgTest()
+{
+  SparseMatrix<T> A;
+  gridLaplacian<T>(12, A);
+
+  std::vector<T> b(A.rows(), T(0));
+  b[5] = T(1);
+  b[A.rows() - 3] = T(-1);
+
+  const T tol = T(1.0e-6);
+  const PreconditionerType precs[] = {NoPreconditioning,
+                                      JacobiPreconditioning,
+                                      IncompleteCholeskyPreconditioning};
+  std::vector<size_t> iterations;
+
+  for (const PreconditionerType p : precs)
+  {
+    std::vector<T> x;
+    iterations.push_back(anpi::solveCG(A, x, b, CGSettings<T>(p, tol)));
+
+    std::vector<T> r = A * x;
+    T err = T(0);
+    for (size_t i = 0; i < r.size(); ++i)
+    {
+      err = std::max(err, std::abs(r[i] - b[i]));
+    }
+    BOOST_CHECK(err < T(10) * tol);
+  }
+
+  // a good preconditioner must reduce the number of iterations
+  BOOST_CHECK(iterations[2] < iterations[0]);
+
+  // an already converged initial guess needs no iterations
+  {
+    std::vector<T> x;
+    anpi::solveCG(A, x, b, CGSettings<T>(IncompleteCholeskyPreconditioning, tol));
+    BOOST_CHECK(anpi::solveCG(A, x, b, CGSettings<T>(JacobiPreconditioning, tol)) == 0u);
+  }
+
+  // a preconditioner set up once serves many right hand sides
+  {
+    CGPreconditioner<T> M;
+    M.setup(A, IncompleteCholeskyPreconditioning);
+    BOOST_CHECK(M.type() == IncompleteCholeskyPreconditioning);
+    for (size_t k = 0; k < 3; ++k)
+    {
+      std::vector<T> x, bk(A.rows(), T(0));
+      bk[k + 1] = T(1);
+      bk[A.rows() - 1] = T(-1);
+      // the type set up overrides the one of the settings
+      std::vector<T> y;
+      BOOST_CHECK(anpi::solveCG(A, x, bk, M, CGSettings<T>(NoPreconditioning, tol)) ==
+                  anpi::solveCG(A, y, bk, CGSettings<T>(IncompleteCholeskyPreconditioning, tol)));
+      const std::vector<T> r = A * x;
+      for (size_t i = 0; i < r.size(); ++i)
+      {
+        BOOST_CHECK(std::abs(r[i] - bk[i]) < T(10) * tol);
+      }
+    }
+  }
+
+  // too few iterations must be reported
+  {
+    std::vector<T> x;
+    BOOST_CHECK_THROW(anpi::solveCG(A, x, b, CGSettings<T>(NoPreconditioning, tol, 2)),
+                      anpi::Exception);
+  }
+
+  // several right hand sides at once
+  {
+    std::vector<std::vector<T> > B(5, std::vector<T>(A.rows(), T(0))), X;
+    for (size_t k = 0; k < B.size(); ++k)
+    {
+      B[k][k + 1] = T(1);
+      B[k][A.rows() - 1 - k] = T(-1);
+    }
+    anpi::solveCG(A, X, B, CGSettings<T>(IncompleteCholeskyPreconditioning, tol));
+    BOOST_CHECK(X.size() == B.size());
+    for (size_t k = 0; k < B.size(); ++k)
+    {
+      std::vector<T> r = A * X[k];
+      T err = T(0);
+      for (size_t i = 0; i < r.size(); ++i)
+      {
+        err = std::max(err, std::abs(r[i] - B[k][i]));
+      }
+      BOOST_CHECK(err < T(10) * tol);
+    }
+
+    // a prepared preconditioner is shared by all right hand sides
+    CGPreconditioner<T> M;
+    M.setup(A, JacobiPreconditioning);
+    std::vector<std::vector<T> > Y;
+    anpi::solveCG(A, Y, B, M, CGSettings<T>(NoPreconditioning, tol));
+    BOOST_CHECK(Y.size() == B.size());
+    for (size_t k = 0; k < B.size(); ++k)
+    {
+      std::vector<T> r = A * Y[k];
+      for (size_t i = 0; i < r.size(); ++i)
+      {
+        BOOST_CHECK(std::abs(r[i] - B[k][i]) < T(10) * tol);
+      }
+    }
+
+    X.clear();
+    BOOST_CHECK_THROW(anpi::solveCG(A, X, B, CGSettings<T>(NoPreconditioning, tol, 2)),
+                      anpi::Exception);
+    Y.clear();
+    BOOST_CHECK_THROW(anpi::solveCG(A, Y, B, M, CGSettings<T>(NoPreconditioning, tol, 2)),
+                      anpi::Exception);
+  }
+}
+
+} // namespace test
+} // namespace anpi
+
+BOOST_AUTO_TEST_SUITE(ConjugateGradient)
+
+BOOST_AUTO_TEST_CASE(Preconditioners)
+{
+  anpi::test::cgTest<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
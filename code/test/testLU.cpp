@@ -15,6 +15,7 @@
 #include "Solver.hpp"
 //#include "LU.hpp"
 #include "MatrixUtils.hpp"
+#include "Parallel.hpp"
 
 #include <iostream>
 #include <exception>
@@ -159,6 +160,147 @@ void luTest(const std::function<void(const Matrix<T> &,
 
 } //end luTest
 
+/// Compare the blocked decomposition with the unblocked one
+template <typename T>
+void blockedTest()
+{
+  // sizes below, equal to and above multiples of the block size
+  const size_t sizes[] = {5, 16, 37, 64};
+  for (const size_t n : sizes)
+  {
+    anpi::Matrix<T> A(n, n), LU, LUb;
+    std::srand(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      for (size_t j = 0; j < n; ++j)
+      {
+        A(i, j) = T(std::rand() % 2001 - 1000) / T(100);
+      }
+    }
+
+    std::vector<size_t> p, pb;
+    anpi::luCrout(A, LU, p);
+    anpi::luCroutBlocked<T, 8>(A, LUb, pb);
+
+    BOOST_CHECK(p == pb);
+
+    const T eps = std::numeric_limits<T>::epsilon();
+    T maxDiff = T(0), maxVal = T(0);
+    for (size_t i = 0; i < n; ++i)
+    {
+      for (size_t j = 0; j < n; ++j)
+      {
+        maxDiff = std::max(maxDiff, std::abs(LU(i, j) - LUb(i, j)));
+        maxVal = std::max(maxVal, std::abs(LU(i, j)));
+      }
+    }
+    BOOST_CHECK(maxDiff <= T(n) * eps * maxVal);
+  }
+}
+
+/// Solve several right hand sides with one factorization
+template <typename T>
+void luSolverTest()
+{
+  anpi::Matrix<T> A = {{0, 2, 0, 1}, {2, 2, 3, 2}, {4, -3, 0, 1.}, {6, 1, -6, -5}};
+  anpi::LUSolver<T> solver;
+  BOOST_CHECK(!solver.factored());
+  solver.factor(A);
+  BOOST_CHECK(solver.factored());
+
+  const std::vector<std::vector<T>> bs = {{0, -2, -7, 6}, {1, 0, 0, 0}, {3, 1, -4, 2}};
+  const T eps = std::sqrt(std::numeric_limits<T>::epsilon());
+  for (const std::vector<T> &b : bs)
+  {
+    std::vector<T> x;
+    solver.solve(b, x);
+    const std::vector<T> br = A * x;
+    for (size_t i = 0; i < b.size(); ++i)
+    {
+      BOOST_CHECK(std::abs(br[i] - b[i]) < eps);
+    }
+  }
+
+  std::vector<T> x, wrong(3, T(1));
+  BOOST_CHECK_THROW(solver.solve(wrong, x), anpi::Exception);
+}
+
+/// Solve many right hand sides at once and compare with one at a time
+template <typename T>
+void batchedSolveTest()
+{
+  anpi::Matrix<T> A = {{0, 2, 0, 1}, {2, 2, 3, 2}, {4, -3, 0, 1.}, {6, 1, -6, -5}};
+  anpi::Matrix<T> B = {{0, 1, 3, -1, 2}, {-2, 0, 1, 4, 0}, {-7, 0, -4, 2, 1}, {6, 0, 2, 0, -3}};
+  const size_t n = B.rows(), m = B.cols();
+  const T eps = std::sqrt(std::numeric_limits<T>::epsilon());
+
+  // triangular substitutions against their single vector versions
+  anpi::Matrix<T> LU, L, U, Y, X;
+  std::vector<size_t> p;
+  anpi::luCrout(A, LU, p);
+  anpi::unpackDoolittle(LU, L, U);
+  anpi::forwardSubstitution(L, B, Y);
+  anpi::backwardSubstitution(U, Y, X);
+  for (size_t c = 0; c < m; ++c)
+  {
+    std::vector<T> y, x;
+    anpi::forwardSubstitution(L, B.column(c), y);
+    anpi::backwardSubstitution(U, y, x);
+    for (size_t i = 0; i < n; ++i)
+    {
+      BOOST_CHECK(std::abs(Y(i, c) - y[i]) < eps);
+      BOOST_CHECK(std::abs(X(i, c) - x[i]) < eps);
+    }
+  }
+
+  // all systems solved with one factorization
+  anpi::LUSolver<T> solver;
+  solver.factor(A);
+  solver.solve(B, X);
+  const anpi::Matrix<T> AX = A * X;
+  for (size_t i = 0; i < n; ++i)
+  {
+    for (size_t c = 0; c < m; ++c)
+    {
+      BOOST_CHECK(std::abs(AX(i, c) - B(i, c)) < eps);
+    }
+  }
+
+  anpi::Matrix<T> wrong(3, 2, T(1));
+  BOOST_CHECK_THROW(solver.solve(wrong, X), anpi::Exception);
+  BOOST_CHECK_THROW(anpi::forwardSubstitution(L, wrong, Y), anpi::Exception);
+}
+
+/// Solve several systems reusing the memory of the same workspace
+template <typename T>
+void workspaceTest()
+{
+  anpi::Matrix<T> A = {{0, 2, 0, 1}, {2, 2, 3, 2}, {4, -3, 0, 1.}, {6, 1, -6, -5}};
+  anpi::Matrix<T> Z = {{5, 1, 0, 0}, {1, 6, 2, 0}, {0, 2, 7, 1}, {1, 0, 1, 8}};
+  const std::vector<T> b = {1, -2, 3, 0.5};
+  const T eps = std::sqrt(std::numeric_limits<T>::epsilon());
+
+  anpi::LUWorkspace<T> ws;
+  std::vector<T> x;
+  anpi::solveLU(A, x, b, ws);
+  const T *luData = ws.LU.data();
+  const T *xData = x.data();
+
+  const anpi::Matrix<T> *systems[] = {&A, &Z, &A};
+  for (const anpi::Matrix<T> *M : systems)
+  {
+    anpi::solveLU(*M, x, b, ws);
+    BOOST_CHECK(ws.LU.data() == luData);
+    BOOST_CHECK(x.data() == xData);
+
+    const std::vector<T> Mx = *M * x;
+    for (size_t i = 0; i < b.size(); ++i)
+    {
+      BOOST_CHECK(std::abs(Mx[i] - b[i]) < eps);
+    }
+  }
+}
+
 template <typename T>
 void invertTest()
 {
@@ -234,6 +376,38 @@ void solverTest()
   BOOST_CHECK(results == exResults);
 }
 
+/// Factorize and substitute on views of larger matrices
+template <typename T>
+void viewTest()
+{
+  // the system of interest is the lower right 3x3 block
+  anpi::Matrix<T> A = {{9, 9, 9, 9}, {9, 4, 1, 2}, {9, 1, 5, 1}, {9, 2, 1, 6}};
+  const std::vector<T> b = {1, -2, 3};
+  const T eps = std::sqrt(std::numeric_limits<T>::epsilon());
+
+  anpi::LUWorkspace<T> ws;
+  anpi::lu(A.block(1, 1, 3, 3), ws);
+  std::vector<T> x;
+  anpi::luSolve(ws.LU, ws.permut, b, x);
+
+  const anpi::Matrix<T> S(A.block(1, 1, 3, 3));
+  std::vector<T> Sx = S * x;
+  for (size_t i = 0; i < b.size(); ++i)
+  {
+    BOOST_CHECK(std::abs(Sx[i] - b[i]) < eps);
+  }
+
+  // the transposed view of a lower triangular matrix is upper triangular
+  const anpi::Matrix<T> L = {{2, 0, 0}, {1, 4, 0}, {-1, 3, 5}};
+  anpi::backwardSubstitution(L.transposed(), b, x);
+  anpi::Matrix<T> U(L.transposed());
+  Sx = U * x;
+  for (size_t i = 0; i < b.size(); ++i)
+  {
+    BOOST_CHECK(std::abs(Sx[i] - b[i]) < eps);
+  }
+}
+
 } // namespace test
 } // namespace anpi
 
@@ -253,6 +427,31 @@ BOOST_AUTO_TEST_CASE(Crout)
   anpi::test::luTest<double>(anpi::luCrout<double>, anpi::unpackCrout<double>);
 }
 
+BOOST_AUTO_TEST_CASE(CroutBlocked)
+{
+  anpi::test::luTest<float>(anpi::luCroutBlocked<float>, anpi::unpackCrout<float>);
+  anpi::test::luTest<double>(anpi::luCroutBlocked<double>, anpi::unpackCrout<double>);
+  anpi::test::blockedTest<float>();
+  anpi::test::blockedTest<double>();
+
+  // the parallel updates must not change the result
+  anpi::setThreads(3);
+  anpi::test::blockedTest<double>();
+  anpi::setThreads(0);
+}
+
+BOOST_AUTO_TEST_CASE(FactorOnce)
+{
+  anpi::test::luSolverTest<float>();
+  anpi::test::luSolverTest<double>();
+  anpi::test::batchedSolveTest<float>();
+  anpi::test::batchedSolveTest<double>();
+  anpi::test::workspaceTest<float>();
+  anpi::test::workspaceTest<double>();
+  anpi::test::viewTest<float>();
+  anpi::test::viewTest<double>();
+}
+
 BOOST_AUTO_TEST_CASE(Inversion)
 {
   anpi::test::invertTest<float>();
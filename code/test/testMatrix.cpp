@@ -11,6 +11,7 @@
 #include <exception>
 #include <cstdlib>
 #include <complex>
+#include <limits>
 
 /**
  * Unit tests for the matrix class
@@ -298,4 +299,252 @@ BOOST_AUTO_TEST_CASE(Arithmetic)
   dispatchTest(testArithmetic);
 }
 
+template <class M>
+void testExpressions()
+{
+  const M a = {{1, 2, 3}, {4, 5, 6}};
+  const M b = {{7, 8, 9}, {10, 11, 12}};
+  const M d = {{3, 1, 4}, {1, 5, 9}};
+
+  { // chains are evaluated into the destination
+    M r = {{5, 9, 8}, {13, 11, 9}};
+    M c = a + b - d;
+    BOOST_CHECK(c == r);
+
+    c = a - (d - b);
+    BOOST_CHECK(c == r);
+
+    BOOST_CHECK(r == a + b - d);
+  }
+
+  { // the destination may be an operand
+    M c(a);
+    c = c + b - c;
+    BOOST_CHECK(c == b);
+
+    c = a;
+    c += b - d;
+    BOOST_CHECK(c == M({{5, 9, 8}, {13, 11, 9}}));
+
+    c -= b - d;
+    BOOST_CHECK(c == a);
+  }
+
+  { // temporaries live until the expression is assigned
+    M c;
+    c = M{{1, 2, 3}, {4, 5, 6}} + b - M{{1, 2, 3}, {4, 5, 6}};
+    BOOST_CHECK(c == b);
+  }
+
+  { // expressions larger than a register, with padding
+    M x(7, 13, anpi::DoNotInitialize), y(7, 13, anpi::DoNotInitialize), r(7, 13);
+    for (size_t i = 0; i < x.rows(); ++i)
+    {
+      for (size_t j = 0; j < x.cols(); ++j)
+      {
+        x(i, j) = typename M::value_type(int(i * 13 + j));
+        y(i, j) = typename M::value_type(int(j) - int(i));
+        r(i, j) = x(i, j) + y(i, j) + y(i, j) - x(i, j);
+      }
+    }
+    M c = x + y + y - x;
+    BOOST_CHECK(c == r);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Expressions)
+{
+  dispatchTest(testExpressions);
+}
+
+template <class M>
+void testProduct()
+{
+  typedef typename M::value_type T;
+
+  {
+    M a = {{1, 2, 3}, {4, 5, 6}};
+    M b = {{7, 8}, {9, 10}, {11, 12}};
+    M r = {{58, 64}, {139, 154}};
+
+    M c = a * b;
+    BOOST_CHECK(c == r);
+
+    BOOST_CHECK_THROW(a * a, anpi::Exception);
+  }
+
+  // sizes crossing the borders of tiles and cache blocks.  The entries
+  // are small integers, so that every method must give exact results.
+  const size_t sizes[][3] = {{1, 1, 1}, {5, 3, 7}, {37, 53, 71}, {70, 600, 90}, {131, 17, 260}};
+  for (const auto &size : sizes)
+  {
+    const size_t rows = size[0], depth = size[1], cols = size[2];
+    M a(rows, depth, anpi::DoNotInitialize);
+    M b(depth, cols, anpi::DoNotInitialize);
+    for (size_t i = 0; i < rows; ++i)
+      for (size_t k = 0; k < depth; ++k)
+        a(i, k) = T(int((i * 7 + k * 3) % 11) - 5);
+    for (size_t k = 0; k < depth; ++k)
+      for (size_t j = 0; j < cols; ++j)
+        b(k, j) = T(int((k * 5 + j * 2) % 7) - 3);
+
+    M r(rows, cols, anpi::DoNotInitialize);
+    for (size_t i = 0; i < rows; ++i)
+    {
+      for (size_t j = 0; j < cols; ++j)
+      {
+        T val = T(0);
+        for (size_t k = 0; k < depth; ++k)
+          val += a(i, k) * b(k, j);
+        r(i, j) = val;
+      }
+    }
+
+    M c = a * b;
+    BOOST_CHECK(c == r);
+
+    ::anpi::fallback::multiply(a, b, c);
+    BOOST_CHECK(c == r);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Product)
+{
+  dispatchTest(testProduct);
+}
+
+template <class M>
+void testVectorProduct()
+{
+  typedef typename M::value_type T;
+
+  {
+    M a = {{1, 2, 3}, {4, 5, 6}};
+    std::vector<T> x = {1, -1, 2};
+    std::vector<T> r = {5, 11};
+    BOOST_CHECK(a * x == r);
+
+    std::vector<T> y = {1, 1};
+    anpi::multiplyAdd(T(2), a, x, T(-3), y);
+    BOOST_CHECK(y == std::vector<T>({7, 19}));
+
+    BOOST_CHECK_THROW(a * r, anpi::Exception);
+    BOOST_CHECK_THROW(anpi::multiplyAdd(T(1), a, x, T(1), x), anpi::Exception);
+  }
+
+  // sizes crossing the borders of the registers, with integer entries
+  const size_t sizes[][2] = {{1, 1}, {5, 3}, {7, 37}, {37, 70}, {6, 129}};
+  for (const auto &size : sizes)
+  {
+    const size_t rows = size[0], cols = size[1];
+    M a(rows, cols, anpi::DoNotInitialize);
+    std::vector<T> x(cols), y(rows);
+    for (size_t i = 0; i < rows; ++i)
+      for (size_t j = 0; j < cols; ++j)
+        a(i, j) = T(int((i * 7 + j * 3) % 11) - 5);
+    for (size_t j = 0; j < cols; ++j)
+      x[j] = T(int(j % 5) - 2);
+    for (size_t i = 0; i < rows; ++i)
+      y[i] = T(int(i % 3));
+
+    std::vector<T> r(rows), s(rows);
+    for (size_t i = 0; i < rows; ++i)
+    {
+      T val = T(0);
+      for (size_t j = 0; j < cols; ++j)
+        val += a(i, j) * x[j];
+      r[i] = val;
+      s[i] = T(3) * val - T(2) * y[i];
+    }
+
+    BOOST_CHECK(a * x == r);
+
+    anpi::multiplyAdd(T(3), a, x, T(-2), y);
+    BOOST_CHECK(y == s);
+
+    // with beta zero the previous content is ignored
+    if (std::numeric_limits<T>::has_quiet_NaN)
+    {
+      std::fill(y.begin(), y.end(), std::numeric_limits<T>::quiet_NaN());
+      anpi::multiplyAdd(T(1), a, x, T(0), y);
+      BOOST_CHECK(y == r);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(VectorProduct)
+{
+  dispatchTest(testVectorProduct);
+}
+
+template <class M>
+void testViews()
+{
+  typedef typename M::value_type T;
+
+  { // blocks, rows, columns and transposed views share the elements
+    M a = {{1, 2, 3, 4}, {5, 6, 7, 8}, {9, 10, 11, 12}};
+
+    auto b = a.block(1, 1, 2, 2);
+    BOOST_CHECK(b.rows() == 2 && b.cols() == 2);
+    BOOST_CHECK(b(0, 0) == T(6) && b(1, 1) == T(11));
+    b(1, 0) = T(0);
+    BOOST_CHECK(a(2, 1) == T(0));
+
+    auto t = a.transposed();
+    BOOST_CHECK(t.rows() == 4 && t.cols() == 3);
+    BOOST_CHECK(t(3, 1) == T(8) && t(0, 2) == T(9));
+
+    BOOST_CHECK(a.rowView(2)(0, 3) == T(12));
+    BOOST_CHECK(a.columnView(2)(1, 0) == T(7));
+
+    a.columnView(0).fill(T(-1));
+    BOOST_CHECK(a(0, 0) == T(-1) && a(2, 0) == T(-1));
+
+    BOOST_CHECK(M(a.block(0, 2, 2, 2)) == M({{3, 4}, {7, 8}}));
+    BOOST_CHECK(M(t.block(1, 0, 2, 2)) == M({{2, 6}, {3, 7}}));
+
+    BOOST_CHECK_THROW(a.block(2, 2, 2, 1), anpi::Exception);
+    BOOST_CHECK_THROW(t.column(3), anpi::Exception);
+  }
+
+  { // assignment of a view of the same matrix
+    M a = {{1, 2, 3}, {4, 5, 6}};
+    a = a.block(0, 1, 2, 2);
+    BOOST_CHECK(a == M({{2, 3}, {5, 6}}));
+
+    a = a.transposed();
+    BOOST_CHECK(a == M({{2, 5}, {3, 6}}));
+
+    M c = {{1, 1}, {1, 1}};
+    c.block(0, 0, 1, 2).assign(a.rowView(1));
+    BOOST_CHECK(c == M({{3, 6}, {1, 1}}));
+  }
+
+  { // products of blocks and transposed views
+    const M a = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+    M c = {{1, 1}, {1, 1}, {1, 1}};
+
+    // c = 2 a(:,0:1) a(0:1,1:2)^T - c
+    anpi::multiplyAdd(T(2),
+                      a.block(0, 0, 3, 2),
+                      a.block(0, 1, 2, 2).transposed(),
+                      T(-1),
+                      c.view());
+    BOOST_CHECK(c == M({{15, 33}, {45, 99}, {75, 165}}));
+
+    std::vector<T> y = {1, 1, 1};
+    anpi::multiplyAdd(T(1), a.transposed(), std::vector<T>{1, 0, -1}, T(0), y);
+    BOOST_CHECK(y == std::vector<T>({-6, -6, -6}));
+
+    BOOST_CHECK_THROW(anpi::multiplyAdd(T(1), a.view(), a.view(), T(0), c.view()),
+                      anpi::Exception);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Views)
+{
+  dispatchTest(testViews);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
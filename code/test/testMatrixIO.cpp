@@ -0,0 +1,146 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, TEC, Costa Rica
+ *
+ * This file is part of the CE3102 Numerical Analysis lecture at TEC
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <cmath>
+#include <complex>
+#include <fstream>
+
+#include "MatrixIO.hpp"
+#include "Solver.hpp"
+
+/**
+ * Unit tests for the binary files of matrices
+ */
+
+namespace anpi
+{
+namespace test
+{
+
+/// Unique name of a file in the temporary directory, removed at the end
+struct TemporaryFile
+{
+  TemporaryFile()
+      : path((boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("anpi-%%%%-%%%%.mat"))
+                 .string()) {}
+
+  ~TemporaryFile()
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+  }
+
+  std::string path;
+};
+
+/// Save and load matrices of the given type and allocators
+template <typename T, class Alloc, class OAlloc>
+void roundTripTest()
+{
+  TemporaryFile file;
+
+  anpi::Matrix<T, Alloc> a(5, 7, anpi::DoNotInitialize);
+  for (size_t i = 0; i < a.rows(); ++i)
+    for (size_t j = 0; j < a.cols(); ++j)
+      a(i, j) = T(int(i * 7 + j)) / T(3);
+
+  anpi::saveMatrix(file.path, a);
+
+  anpi::Matrix<T, Alloc> b;
+  anpi::loadMatrix(file.path, b);
+  BOOST_CHECK(b == a);
+
+  // other padding: loaded row by row
+  anpi::Matrix<T, OAlloc> c;
+  anpi::loadMatrix(file.path, c);
+  BOOST_CHECK(c.rows() == a.rows() && c.cols() == a.cols());
+  bool same = true;
+  for (size_t i = 0; i < a.rows(); ++i)
+    for (size_t j = 0; j < a.cols(); ++j)
+      same = same && (c(i, j) == a(i, j));
+  BOOST_CHECK(same);
+
+  // without copying
+  anpi::MappedMatrix<T> m(file.path);
+  BOOST_CHECK(m.rows() == a.rows() && m.cols() == a.cols());
+  BOOST_CHECK(m.view().rowStride() == a.dcols());
+  BOOST_CHECK(anpi::Matrix<T>(m.view()) == anpi::Matrix<T>(a.view()));
+
+  // writing through the view does not change the file
+  m.view()(0, 0) = T(42);
+  anpi::loadMatrix(file.path, b);
+  BOOST_CHECK(b(0, 0) == a(0, 0));
+}
+
+} // namespace test
+} // namespace anpi
+
+BOOST_AUTO_TEST_SUITE(MatrixIO)
+
+BOOST_AUTO_TEST_CASE(RoundTrip)
+{
+  typedef std::allocator<float> alloc;
+  typedef anpi::aligned_row_allocator<float> ralloc;
+
+  anpi::test::roundTripTest<float, ralloc, alloc>();
+  anpi::test::roundTripTest<double, alloc, ralloc>();
+  anpi::test::roundTripTest<std::complex<double>, ralloc, alloc>();
+}
+
+BOOST_AUTO_TEST_CASE(Factorization)
+{
+  anpi::test::TemporaryFile luFile, permutFile;
+
+  const anpi::Matrix<double> A = {{0, 2, 0, 1}, {2, 2, 3, 2}, {4, -3, 0, 1.}, {6, 1, -6, -5}};
+  const std::vector<double> b = {1, -2, 3, 0.5};
+
+  {
+    anpi::LUWorkspace<double> ws;
+    anpi::lu(A, ws);
+    anpi::saveMatrix(luFile.path, ws.LU);
+    anpi::saveVector(permutFile.path, ws.permut);
+  }
+
+  // solve with the stored decomposition, as in a later run
+  anpi::MappedMatrix<double> LU(luFile.path);
+  std::vector<size_t> permut;
+  anpi::loadVector(permutFile.path, permut);
+
+  std::vector<double> x;
+  anpi::luSolve(LU.view(), permut, b, x);
+
+  const std::vector<double> Ax = A * x;
+  for (size_t i = 0; i < b.size(); ++i)
+  {
+    BOOST_CHECK(std::abs(Ax[i] - b[i]) < 1e-12);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Errors)
+{
+  anpi::test::TemporaryFile file;
+  anpi::Matrix<float> a;
+
+  BOOST_CHECK_THROW(anpi::loadMatrix(file.path, a), anpi::Exception);
+
+  anpi::saveMatrix(file.path, anpi::Matrix<float>(3, 3, 1.f));
+  anpi::Matrix<double> d;
+  BOOST_CHECK_THROW(anpi::loadMatrix(file.path, d), anpi::Exception);
+  BOOST_CHECK_THROW(anpi::MappedMatrix<int>(file.path), anpi::Exception);
+
+  {
+    std::ofstream out(file.path, std::ios::binary | std::ios::trunc);
+    out << "not a matrix, but long enough to hold a complete header.........";
+  }
+  BOOST_CHECK_THROW(anpi::loadMatrix(file.path, a), anpi::Exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,208 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, TEC, Costa Rica
+ *
+ * This file is part of the CE3102 Numerical Analysis lecture at TEC
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "Multigrid.hpp"
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+
+#include <cmath>
+
+namespace anpi
+{
+namespace test
+{
+
+/**
+ * Build the Laplacian of a rows x cols resistor grid with one grounded
+ * corner.  Some resistors are walls, with a conductance a thousand
+ * times smaller than the free cells.
+ */
+template <typename T>
+void wallGrid(const size_t rows, const size_t cols, GridOperator<T> &A)
+{
+  A.allocate(rows, cols);
+  for (size_t i = 0, k = 0; i < rows; ++i)
+  {
+    for (size_t j = 0; j < cols; ++j, ++k)
+    {
+      // a vertical wall with a door, and a horizontal one
+      const bool wall = ((j == cols / 3) && (i > 2)) ||
+                        ((i == rows / 2) && (j > cols / 2));
+      const T g = wall ? T(0.001) : T(1);
+      if (j + 1 < cols)
+      {
+        A.east[k] = g;
+        A.diag[k] += g;
+        A.diag[k + 1] += g;
+      }
+      if (i + 1 < rows)
+      {
+        A.south[k] = g;
+        A.diag[k] += g;
+        A.diag[k + cols] += g;
+      }
+    }
+  }
+  A.diag[0] = T(1);
+  A.east[0] = A.south[0] = T(0);
+}
+
+/// Maximum absolute residual of the solution
+template <typename T>
+T maxResidual(const SparseMatrix<T> &A,
+              const std::vector<T> &x,
+              const std::vector<T> &b)
+{
+  const std::vector<T> r = A * x;
+  T err = T(0);
+  for (size_t i = 0; i < r.size(); ++i)
+  {
+    err = std::max(err, std::abs(r[i] - b[i]));
+  }
+  return err;
+}
+
+/// Solve grid systems with both cycle types
+template <typename T>
+void multigridTest()
+{
+  const size_t sizes[][2] = {{5, 4}, {33, 33}, {40, 57}};
+  const T tol = T(1.0e-8);
+
+  for (const auto &size : sizes)
+  {
+    GridOperator<T> A;
+    wallGrid<T>(size[0], size[1], A);
+
+    SparseMatrix<T> S;
+    A.toSparse(S);
+
+    std::vector<T> b(A.nodes(), T(0));
+    b[A.nodes() / 3] = T(1);
+    b[A.nodes() - 2] = T(-1);
+
+    // the grid operator and its sparse form must agree
+    {
+      std::vector<T> y;
+      A.apply(b, y);
+      const std::vector<T> z = S * b;
+      for (size_t i = 0; i < y.size(); ++i)
+      {
+        BOOST_CHECK(std::abs(y[i] - z[i]) < T(1.0e-12));
+      }
+    }
+
+    const CycleType cycles[] = {VCycle, WCycle};
+    for (const CycleType c : cycles)
+    {
+      for (const bool accel : {false, true})
+      {
+        Multigrid<T> mg;
+        mg.setup(A, MultigridSettings<T>(c, tol, 100u, 2u, accel));
+        std::vector<T> x;
+        const size_t n = mg.solve(x, b);
+        BOOST_CHECK(n < (accel ? 20u : 30u));
+        BOOST_CHECK(maxResidual(S, x, b) < T(10) * tol);
+
+        // an already converged initial guess needs no cycles
+        BOOST_CHECK(mg.solve(x, b) == 0u);
+
+        // a workspace can be reused for several right hand sides
+        typename Multigrid<T>::Workspace ws;
+        for (size_t k = 0; k < 2; ++k)
+        {
+          std::vector<T> bk(A.nodes(), T(0)), xk;
+          bk[k + 1] = T(1);
+          bk[A.nodes() - 1] = T(-1);
+          mg.solve(xk, bk, ws);
+          BOOST_CHECK(maxResidual(S, xk, bk) < T(10) * tol);
+        }
+      }
+    }
+
+    // the cycles of a shared hierarchy precondition the conjugate gradient
+    {
+      Multigrid<T> mg;
+      mg.setup(A, MultigridSettings<T>(VCycle, tol, 100u, 2u, false));
+      typename Multigrid<T>::Workspace ws;
+      std::vector<T> x;
+      const size_t n = pcg(S, x, b, typename Multigrid<T>::Preconditioner(mg, ws), tol, 100u);
+      BOOST_CHECK(n < 20u);
+      BOOST_CHECK(maxResidual(S, x, b) < T(10) * tol);
+    }
+  }
+
+  // a long corridor is coarsened only along its length once it has
+  // two rows: 3x2000, 2x1000, 2x500, ..., 2x63 and a coarsest 2x32 grid
+  {
+    GridOperator<T> A;
+    wallGrid<T>(3, 2000, A);
+    SparseMatrix<T> S;
+    A.toSparse(S);
+    std::vector<T> b(A.nodes(), T(0));
+    b[1500] = T(1);
+    b[A.nodes() - 1] = T(-1);
+    for (const bool accel : {false, true})
+    {
+      Multigrid<T> mg;
+      mg.setup(A, MultigridSettings<T>(VCycle, tol, 100u, 2u, accel));
+      BOOST_CHECK(mg.levels() == 7u);
+      std::vector<T> x;
+      mg.solve(x, b);
+      BOOST_CHECK(maxResidual(S, x, b) < T(10) * tol);
+    }
+  }
+
+  // too few cycles must be reported
+  {
+    GridOperator<T> A;
+    wallGrid<T>(65, 65, A);
+    std::vector<T> b(A.nodes(), T(0));
+    b[100] = T(1);
+    Multigrid<T> mg;
+    mg.setup(A, MultigridSettings<T>(VCycle, T(1.0e-12), 1));
+    std::vector<T> x;
+    BOOST_CHECK_THROW(mg.solve(x, b), anpi::Exception);
+  }
+
+  // the conjugate gradient cannot be preconditioned with a non-symmetric
+  // cycle, but plain cycles may smooth differently before and after
+  {
+    GridOperator<T> A;
+    wallGrid<T>(33, 33, A);
+    SparseMatrix<T> S;
+    A.toSparse(S);
+    std::vector<T> b(A.nodes(), T(0));
+    b[100] = T(1);
+    MultigridSettings<T> settings(VCycle, tol, 100u, 2u, true);
+    settings.postSmoothing = 1u;
+    Multigrid<T> mg;
+    BOOST_CHECK_THROW(mg.setup(A, settings), anpi::Exception);
+
+    settings.accelerate = false;
+    mg.setup(A, settings);
+    std::vector<T> x;
+    mg.solve(x, b);
+    BOOST_CHECK(maxResidual(S, x, b) < T(10) * tol);
+  }
+}
+
+} // namespace test
+} // namespace anpi
+
+BOOST_AUTO_TEST_SUITE(Multigrid)
+
+BOOST_AUTO_TEST_CASE(Cycles)
+{
+  anpi::test::multigridTest<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
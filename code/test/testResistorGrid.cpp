@@ -21,6 +21,10 @@
 #include <functional>
 
 #include <cmath>
+#include <fstream>
+#include <thread>
+
+#include <boost/filesystem.hpp>
 
 namespace anpi
 {
@@ -106,6 +110,33 @@ void indexTest()
     std::cout << calculatedResistor;
 
     BOOST_CHECK(calculatedResistor == testResistor);
+
+    // the tables agree with the checked conversions for all resistors
+    const size_t cols = 10;
+    bool consistent = true;
+    for (size_t r = 0; r < 180; ++r)
+    {
+        const indexPair p = rg.indexToNodes(r);
+        const ResistorNodes &ends = rg.resistorNodes(r);
+        consistent = consistent && (ends.first == p.row1 * cols + p.col1) &&
+                     (ends.second == p.row2 * cols + p.col2) &&
+                     (rg.nodesToIndex(p.row2, p.col2, p.row1, p.col1) == r);
+    }
+    BOOST_CHECK(consistent);
+
+    // borders
+    const NodeResistors &corner = rg.nodeResistors(0);
+    BOOST_CHECK(corner.up == NoResistor && corner.left == NoResistor);
+    BOOST_CHECK(corner.right == 0 && corner.down == 9);
+    const NodeResistors &last = rg.nodeResistors(99);
+    BOOST_CHECK(last.down == NoResistor && last.right == NoResistor);
+    BOOST_CHECK(last.up == 170 && last.left == 179);
+    const NodeResistors &inner = rg.nodeResistors(12);
+    BOOST_CHECK(inner.up == 11 && inner.left == 20 && inner.right == 21 && inner.down == 30);
+
+    BOOST_CHECK_THROW(rg.indexToNodes(180), anpi::Exception);
+    BOOST_CHECK_THROW(rg.nodesToIndex(0, 0, 1, 1), anpi::Exception);
+    BOOST_CHECK_THROW(rg.nodesToIndex(0, 9, 0, 10), anpi::Exception);
 } //END OF indexTest()
 
 void testDespla()
@@ -127,6 +158,38 @@ void testDespla()
 
     rg.printDesX();
     rg.printDesY();
+
+    // compare with the currents around each node of a wider map
+    const size_t rows = 5, cols = 11;
+    Matrix<float> map(rows, cols, 1.0f);
+    map(2, 3) = map(2, 4) = map(3, 7) = 0.0f;
+    rg.setRawMap(map);
+    rg.navigate({0, 1, 4, 9});
+    rg.calcDesplazamiento();
+
+    const std::vector<double> &x = rg.getX();
+    const Matrix<float> &dx = rg.getXDespla(), &dy = rg.getYDespla();
+    BOOST_CHECK(dx.rows() == rows && dx.cols() == cols);
+    BOOST_CHECK(dy.rows() == rows && dy.cols() == cols);
+    for (size_t i = 0; i < rows; ++i)
+    {
+        for (size_t j = 0; j < cols; ++j)
+        {
+            double ex = 0.0, ey = 0.0;
+            int nx = 0, ny = 0;
+            if (j > 0)
+                ex += x[rg.nodesToIndex(i, j - 1, i, j)], ++nx;
+            if (j + 1 < cols)
+                ex += x[rg.nodesToIndex(i, j, i, j + 1)], ++nx;
+            if (i > 0)
+                ey += x[rg.nodesToIndex(i - 1, j, i, j)], ++ny;
+            if (i + 1 < rows)
+                ey += x[rg.nodesToIndex(i, j, i + 1, j)], ++ny;
+
+            BOOST_CHECK(std::abs(dx(i, j) - ex / nx) < 1.0e-6);
+            BOOST_CHECK(std::abs(dy(i, j) - ey / ny) < 1.0e-6);
+        }
+    }
 }
 
 void testNavigate()
@@ -185,6 +248,513 @@ void testNavigate()
     ::anpi::benchmark::plotPath(x, y, "The rute of current is", "b");*/
 } //end test navigate
 
+/// The precomputed resistances must match the pixels of each resistor
+void testResistances()
+{
+    // wide enough to use full SIMD registers and a scalar tail
+    const size_t rows = 7, cols = 21;
+    Matrix<float> map(rows, cols, 1.0f);
+    for (size_t i = 0; i < rows; ++i)
+        for (size_t j = 0; j < cols; ++j)
+            if ((i * 5 + j * 3) % 7 == 0)
+                map(i, j) = 0.0f;
+
+    ResistorGrid rg;
+    rg.setRawMap(map);
+
+    const size_t resistors = rows * cols * 2 - (rows + cols);
+    for (size_t r = 0; r < resistors; ++r)
+    {
+        const indexPair p = rg.indexToNodes(r);
+        const bool blocked = (map(p.row1, p.col1) == 0.0f) ||
+                             (map(p.row2, p.col2) == 0.0f);
+        BOOST_CHECK(rg.getResistanceValue(int(r)) == (blocked ? MEGAOHM : OHM));
+    }
+
+    BOOST_CHECK_THROW(rg.getResistanceValue(int(resistors)), anpi::Exception);
+
+    // grayscale: each resistor is as hard as its darkest pixel
+    for (size_t i = 0; i < rows; ++i)
+        for (size_t j = 0; j < cols; ++j)
+            map(i, j) = float((i * 37 + j * 11) % 256) / 255.0f;
+    rg.setRawMap(map);
+    const LinearConductance policy(500.0, 2.0);
+    rg.setResistanceModel(ResistanceModel(policy));
+
+    for (size_t r = 0; r < resistors; ++r)
+    {
+        const indexPair p = rg.indexToNodes(r);
+        const double expected = std::max(policy(map(p.row1, p.col1)),
+                                         policy(map(p.row2, p.col2)));
+        BOOST_CHECK(std::abs(rg.getResistanceValue(int(r)) - expected) <
+                    1.0e-5 * expected);
+    }
+    BOOST_CHECK(rg.getResistanceValue(0) <= 500.0);
+    BOOST_CHECK(rg.getResistanceValue(0) >= 2.0);
+}
+
+/// The currents and paths of the grid are discarded with its map or resistances
+void testStaleResults()
+{
+    Matrix<float> map(5, 6, 1.0f);
+    const indexPair query = {0, 0, 4, 5};
+
+    ResistorGrid rg;
+    rg.setRawMap(map);
+    rg.navigate(query);
+    rg.calculateSimplePath(query);
+    rg.calculateSmoothPath(query);
+    BOOST_CHECK(!rg.getSimplePath().empty());
+
+    // another map of the same size
+    map(2, 1) = map(2, 2) = map(2, 3) = 0.0f;
+    rg.setRawMap(map);
+    BOOST_CHECK(rg.getX().empty());
+    BOOST_CHECK(rg.getSimplePath().empty());
+    BOOST_CHECK(rg.getSmoothPath().empty());
+    BOOST_CHECK_THROW(rg.calculateSimplePath(query), anpi::Exception);
+    BOOST_CHECK_THROW(rg.calculateSmoothPath(query), anpi::Exception);
+
+    // other resistances for the same map
+    rg.navigate(query);
+    rg.calculateSimplePath(query);
+    rg.calculateSmoothPath(query);
+    rg.setResistanceModel(ResistanceModel(LinearConductance(500.0, 2.0)));
+    BOOST_CHECK(rg.getX().empty());
+    BOOST_CHECK(rg.getSimplePath().empty());
+    BOOST_CHECK(rg.getSmoothPath().empty());
+    BOOST_CHECK_THROW(rg.calculateSimplePath(query), anpi::Exception);
+    BOOST_CHECK_THROW(rg.calculateSmoothPath(query), anpi::Exception);
+
+    // the context of a caller keeps its currents, but they belong to
+    // the previous map or resistances
+    NavigationContext context;
+    rg.prepare();
+    rg.navigate(query, context);
+    rg.calculateSimplePath(query, context);
+    rg.calculateSmoothPath(query, context);
+    map(2, 2) = 1.0f;
+    rg.setRawMap(map);
+    BOOST_CHECK_THROW(rg.calculateSimplePath(query, context), anpi::Exception);
+    BOOST_CHECK_THROW(rg.calculateSmoothPath(query, context), anpi::Exception);
+
+    rg.prepare();
+    rg.navigate(query, context);
+    rg.calculateSmoothPath(query, context);
+    rg.setResistanceModel(ResistanceModel(LinearConductance()));
+    BOOST_CHECK_THROW(rg.calculateSimplePath(query, context), anpi::Exception);
+    BOOST_CHECK_THROW(rg.calculateSmoothPath(query, context), anpi::Exception);
+
+    // until it navigates again
+    rg.prepare();
+    rg.navigate(query, context);
+    rg.calculateSimplePath(query, context);
+    rg.calculateSmoothPath(query, context);
+    BOOST_CHECK(!context.simplePath.empty());
+}
+
+/// Smooth paths follow the current field from the start to the end node
+void testSmoothPath()
+{
+    const size_t rows = 5, cols = 11;
+    ResistorGrid rg;
+
+    // on a blank map the path runs straight along the row
+    rg.setRawMap(Matrix<float>(rows, cols, 1.0f));
+    rg.navigate({2, 0, 2, 10});
+    rg.calculateSmoothPath({2, 0, 2, 10});
+
+    const std::vector<PathPoint> &straight = rg.getSmoothPath();
+    BOOST_CHECK(straight.size() > 2);
+    BOOST_CHECK(straight.front().row == 2.0 && straight.front().col == 0.0);
+    BOOST_CHECK(straight.back().row == 2.0 && straight.back().col == 10.0);
+    for (size_t k = 1; k < straight.size(); ++k)
+    {
+        BOOST_CHECK(std::abs(straight[k].row - 2.0) < 1.0e-3);
+        BOOST_CHECK(straight[k].col > straight[k - 1].col);
+    }
+
+    // a wall in the middle column leaves a gap only in the last row
+    Matrix<float> map(rows, cols, 1.0f);
+    for (size_t i = 0; i + 1 < rows; ++i)
+        map(i, 5) = 0.0f;
+    rg.setRawMap(map);
+    rg.setSolverMethod(NodalCholesky);
+    rg.navigate({0, 1, 0, 9});
+    rg.calculateSmoothPath({0, 1, 0, 9});
+
+    const std::vector<PathPoint> &detour = rg.getSmoothPath();
+    BOOST_CHECK(detour.back().row == 0.0 && detour.back().col == 9.0);
+    for (size_t k = 1; k < detour.size(); ++k)
+    {
+        // consecutive points are never further apart than the longest step
+        BOOST_CHECK(std::hypot(detour[k].row - detour[k - 1].row,
+                               detour[k].col - detour[k - 1].col) <= 1.0 + 1.0e-9);
+        // the wall is crossed below its last black pixel
+        if ((detour[k - 1].col - 5.0) * (detour[k].col - 5.0) <= 0.0)
+        {
+            BOOST_CHECK(detour[k].row > 3.0);
+        }
+    }
+
+    // a new navigation replaces the field
+    rg.navigate({0, 9, 0, 1});
+    rg.calculateSmoothPath({0, 9, 0, 1});
+    BOOST_CHECK(rg.getSmoothPath().back().col == 1.0);
+
+    // end nodes beside obstacles, where the field turns abruptly
+    Matrix<float> pixels(7, 8, 1.0f);
+    pixels(2, 3) = pixels(3, 3) = pixels(4, 5) = 0.0f;
+    rg.setRawMap(pixels);
+    const indexPair beside[] = {{2, 5, 2, 2}, {3, 2, 3, 5}, {5, 3, 1, 3}};
+    for (const indexPair &nodes : beside)
+    {
+        rg.navigate(nodes);
+        rg.calculateSmoothPath(nodes);
+        const std::vector<PathPoint> &path = rg.getSmoothPath();
+        BOOST_CHECK(path.back().row == double(nodes.row2) && path.back().col == double(nodes.col2));
+        for (size_t k = 1; k < path.size(); ++k)
+        {
+            BOOST_CHECK(std::hypot(path[k].row - path[k - 1].row,
+                                   path[k].col - path[k - 1].col) <= 1.0 + 1.0e-9);
+        }
+    }
+}
+
+/// A batch of queries gives the same paths as single navigations
+void testBatch()
+{
+    const size_t rows = 6, cols = 9;
+    Matrix<float> map(rows, cols, 1.0f);
+    map(1, 2) = map(2, 2) = map(3, 6) = map(4, 6) = 0.0f;
+
+    // more queries than solved together in one block
+    std::vector<indexPair> queries;
+    for (size_t q = 0; q < 40; ++q)
+    {
+        const size_t start = (q * 7) % (rows * cols);
+        const size_t end = (q * 13 + 5) % (rows * cols);
+        if ((start != end) && (map(start / cols, start % cols) != 0.0f) &&
+            (map(end / cols, end % cols) != 0.0f))
+            queries.push_back({start / cols, start % cols, end / cols, end % cols});
+    }
+    BOOST_REQUIRE(queries.size() > 32);
+
+    const SolverMethod methods[] = {MeshSparseLU, NodalConjugateGradient,
+                                    NodalMultigrid, NodalCholesky};
+    for (const SolverMethod method : methods)
+    {
+        ResistorGrid rg;
+        rg.setRawMap(map);
+        rg.setSolverMethod(method);
+
+        const std::vector<NavigationResult> results = rg.navigateBatch(queries, true);
+        BOOST_CHECK(results.size() == queries.size());
+
+        for (size_t q = 0; q < queries.size(); ++q)
+        {
+            rg.navigate(queries[q]);
+            rg.calculateSimplePath(queries[q]);
+            rg.calculateSmoothPath(queries[q]);
+
+            BOOST_CHECK(results[q].simplePath == rg.getSimplePath());
+
+            const std::vector<PathPoint> &smooth = rg.getSmoothPath();
+            BOOST_CHECK(results[q].smoothPath.size() == smooth.size());
+            for (size_t k = 0; k < std::min(smooth.size(), results[q].smoothPath.size()); ++k)
+            {
+                BOOST_CHECK(std::abs(results[q].smoothPath[k].row - smooth[k].row) < 1.0e-6);
+                BOOST_CHECK(std::abs(results[q].smoothPath[k].col - smooth[k].col) < 1.0e-6);
+            }
+        }
+    }
+
+    ResistorGrid rg;
+    rg.setRawMap(map);
+    queries.push_back({0, 0, 0, 0});
+    BOOST_CHECK_THROW(rg.navigateBatch(queries), anpi::Exception);
+}
+
+/// Many threads navigate on the same grid, each with its own context
+void testConcurrent()
+{
+    const size_t rows = 7, cols = 8;
+    Matrix<float> map(rows, cols, 1.0f);
+    map(2, 3) = map(3, 3) = map(4, 5) = 0.0f;
+
+    std::vector<indexPair> queries;
+    for (size_t q = 0; q < 24; ++q)
+    {
+        const size_t start = (q * 5 + 1) % (rows * cols);
+        const size_t end = (q * 11 + 30) % (rows * cols);
+        if (start != end)
+            queries.push_back({start / cols, start % cols, end / cols, end % cols});
+    }
+
+    const SolverMethod methods[] = {MeshSparseLU, NodalConjugateGradient,
+                                    NodalMultigrid, NodalCholesky};
+    for (const SolverMethod method : methods)
+    {
+        ResistorGrid rg;
+        rg.setRawMap(map);
+        rg.setSolverMethod(method);
+
+        // the reference, through the non-const interface
+        std::vector<std::vector<double>> currents(queries.size());
+        std::vector<std::vector<int>> paths(queries.size());
+        for (size_t q = 0; q < queries.size(); ++q)
+        {
+            rg.navigate(queries[q]);
+            rg.calculateSimplePath(queries[q]);
+            currents[q] = rg.getX();
+            paths[q] = rg.getSimplePath();
+        }
+
+        // four workers, each with its own context, share the grid
+        const ResistorGrid &shared = rg;
+        const size_t workers = 4;
+        std::vector<int> failures(workers, 0);
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < workers; ++w)
+        {
+            threads.emplace_back([&, w]() {
+                NavigationContext context;
+                for (size_t q = w; q < queries.size(); q += workers)
+                {
+                    try
+                    {
+                        shared.navigate(queries[q], context);
+                        shared.calculateSimplePath(queries[q], context);
+                        shared.calculateSmoothPath(queries[q], context);
+                    }
+                    catch (...)
+                    {
+                        ++failures[w];
+                        continue;
+                    }
+
+                    failures[w] += (context.simplePath != paths[q]) ? 1 : 0;
+                    failures[w] += (context.x.size() != currents[q].size()) ? 1 : 0;
+                    for (size_t r = 0; r < std::min(context.x.size(), currents[q].size()); ++r)
+                    {
+                        failures[w] += (std::abs(context.x[r] - currents[q][r]) > 1.0e-9) ? 1 : 0;
+                    }
+                }
+            });
+        }
+        for (std::thread &t : threads)
+            t.join();
+        for (size_t w = 0; w < workers; ++w)
+            BOOST_CHECK(failures[w] == 0);
+    }
+
+    // the const interface does not prepare the nodal system by itself
+    ResistorGrid rg;
+    rg.setRawMap(map);
+    rg.setSolverMethod(NodalCholesky);
+    NavigationContext context;
+    const ResistorGrid &unprepared = rg;
+    BOOST_CHECK_THROW(unprepared.navigate(queries[0], context), anpi::Exception);
+    rg.prepare();
+    BOOST_CHECK(unprepared.navigate(queries[0], context));
+}
+
+/// The temporaries of the solvers reuse the region of the context
+void testArena()
+{
+    Matrix<float> map(6, 9, 1.0f);
+    map(1, 4) = map(2, 4) = map(3, 4) = 0.0f;
+    const indexPair query = {0, 0, 5, 8};
+
+    const SolverMethod methods[] = {MeshSparseLU, NodalConjugateGradient};
+    for (const SolverMethod method : methods)
+    {
+        ResistorGrid rg;
+        rg.setRawMap(map);
+        rg.setSolverMethod(method);
+        rg.prepare();
+
+        // the first navigation sizes the region, the next ones fit in it
+        NavigationContext context;
+        rg.navigate(query, context);
+        const size_t capacity = context.arena.capacity();
+        BOOST_CHECK(capacity > 0u);
+        BOOST_CHECK(context.arena.used() == 0u);
+        for (int k = 0; k < 3; ++k)
+        {
+            rg.navigate(query, context);
+            BOOST_CHECK(context.arena.capacity() == capacity);
+        }
+        BOOST_CHECK(Arena::current() == nullptr);
+    }
+}
+
+/// Compare the currents of the nodal solvers and the mesh formulation
+void testNodal()
+{
+    std::string mapPath = std::string(ANPI_DATA_PATH) + "/6x4map.png";
+    ResistorGrid rg;
+    rg.build(mapPath);
+
+    const indexPair tests[] = {{1, 0, 3, 4}, {0, 1, 2, 2}, {3, 5, 0, 3}, {0, 0, 3, 5}};
+    for (const indexPair &test : tests)
+    {
+        rg.setSolverMethod(MeshSparseLU);
+        rg.navigate(test);
+        std::vector<double> mesh = rg.getX();
+
+        const SolverMethod methods[] = {NodalConjugateGradient, NodalMultigrid,
+                                        NodalCholesky};
+        for (const SolverMethod method : methods)
+        {
+            rg.setSolverMethod(method);
+            rg.navigate(test);
+            const std::vector<double> &nodal = rg.getX();
+
+            BOOST_CHECK(mesh.size() == nodal.size());
+            for (size_t i = 0; i < mesh.size(); ++i)
+            {
+                BOOST_CHECK(std::abs(mesh[i] - nodal[i]) < 1.0e-6);
+            }
+        }
+    }
+}
+
+/// All solvers must agree also with a grayscale resistance model
+void testGrayscaleModel()
+{
+    std::string mapPath = std::string(ANPI_DATA_PATH) + "/6x4map.png";
+    ResistorGrid rg;
+    rg.build(mapPath);
+    rg.setResistanceModel(ResistanceModel(LinearConductance(50.0, 1.0)));
+
+    const indexPair test = {1, 0, 3, 4};
+    rg.setSolverMethod(MeshSparseLU);
+    rg.navigate(test);
+    const std::vector<double> mesh = rg.getX();
+
+    const SolverMethod methods[] = {NodalConjugateGradient, NodalMultigrid,
+                                    NodalCholesky};
+    for (const SolverMethod method : methods)
+    {
+        rg.setSolverMethod(method);
+        rg.navigate(test);
+        const std::vector<double> &nodal = rg.getX();
+
+        BOOST_CHECK(mesh.size() == nodal.size());
+        for (size_t i = 0; i < mesh.size(); ++i)
+        {
+            BOOST_CHECK(std::abs(mesh[i] - nodal[i]) < 1.0e-6);
+        }
+    }
+}
+
+/// Navigations on the same map must reuse the prepared nodal system
+void testFactorOnce()
+{
+    std::string mapPath = std::string(ANPI_DATA_PATH) + "/10x12map.png";
+    ResistorGrid cached;
+    cached.build(mapPath);
+    cached.setSolverMethod(NodalCholesky);
+
+    const indexPair tests[] = {{1, 0, 3, 4}, {0, 1, 9, 7}, {11, 9, 0, 0}};
+    for (const indexPair &test : tests)
+    {
+        cached.navigate(test);
+
+        ResistorGrid fresh;
+        fresh.build(mapPath);
+        fresh.setSolverMethod(NodalConjugateGradient);
+        fresh.navigate(test);
+
+        const std::vector<double> &x = cached.getX();
+        const std::vector<double> &ref = fresh.getX();
+        BOOST_CHECK(x.size() == ref.size());
+        for (size_t i = 0; i < x.size(); ++i)
+        {
+            BOOST_CHECK(std::abs(x[i] - ref[i]) < 1.0e-6);
+        }
+    }
+}
+
+/// A restarted process must reuse the factorization stored in the cache
+void testCache()
+{
+    namespace fs = boost::filesystem;
+    const fs::path dir = fs::temp_directory_path() /
+                         fs::unique_path("anpi-cache-%%%%-%%%%");
+    std::string mapPath = std::string(ANPI_DATA_PATH) + "/10x12map.png";
+    const indexPair test = {1, 0, 9, 7};
+
+    ResistorGrid first;
+    first.build(mapPath);
+    first.setSolverMethod(NodalCholesky);
+    first.setCacheDirectory(dir.string());
+    first.navigate(test);
+    const std::vector<double> ref = first.getX();
+
+    // exactly one entry, without temporary files
+    std::vector<fs::path> entries;
+    for (fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it)
+        entries.push_back(it->path());
+    BOOST_REQUIRE(entries.size() == 1u);
+    BOOST_CHECK(entries[0].extension() == ".chol");
+    const auto size = fs::file_size(entries[0]);
+
+    ResistorGrid second;
+    second.build(mapPath);
+    second.setSolverMethod(NodalCholesky);
+    second.setCacheDirectory(dir.string());
+    second.navigate(test);
+    BOOST_CHECK(second.getX() == ref);
+
+    // a damaged entry is computed and stored again
+    fs::resize_file(entries[0], size / 2);
+    ResistorGrid third;
+    third.build(mapPath);
+    third.setSolverMethod(NodalCholesky);
+    third.setCacheDirectory(dir.string());
+    third.navigate(test);
+    BOOST_CHECK(third.getX() == ref);
+    BOOST_CHECK(fs::file_size(entries[0]) == size);
+
+    // the entry of a map with as many nodes but another shape does not
+    // fit the profile of the nodal matrix, and is computed again
+    ResistorGrid other;
+    other.setRawMap(Matrix<float>(10, 12, 1.0f));
+    other.setSolverMethod(NodalCholesky);
+    other.setCacheDirectory(dir.string());
+    other.navigate({0, 0, 9, 11});
+    for (fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it)
+    {
+        if (it->path() != entries[0])
+            fs::copy_file(it->path(), entries[0], fs::copy_option::overwrite_if_exists);
+    }
+    BOOST_CHECK(fs::file_size(entries[0]) != size);
+
+    ResistorGrid fourth;
+    fourth.build(mapPath);
+    fourth.setSolverMethod(NodalCholesky);
+    fourth.setCacheDirectory(dir.string());
+    fourth.navigate(test);
+    BOOST_CHECK(fourth.getX() == ref);
+    BOOST_CHECK(fs::file_size(entries[0]) == size);
+
+    // a map whose factor exceeds the size limit is rejected before
+    // allocating it, and leaves no entry
+    ResistorGrid wide;
+    wide.setRawMap(Matrix<float>(80, 2000, 1.0f));
+    wide.setSolverMethod(NodalCholesky);
+    wide.setCacheDirectory(dir.string());
+    BOOST_CHECK_THROW(wide.prepare(), anpi::Exception);
+    size_t count = 0;
+    for (fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it)
+        ++count;
+    BOOST_CHECK(count == 2u);
+
+    fs::remove_all(dir);
+}
+
 void testBuild()
 {
     // Build the name of the image in the data path
@@ -204,15 +774,65 @@ BOOST_AUTO_TEST_CASE(IndexConversion)
 
     anpi::test::indexTest();
 }
+BOOST_AUTO_TEST_CASE(Resistances)
+{
+    anpi::test::testResistances();
+}
+
 BOOST_AUTO_TEST_CASE(Navigate)
 {
     anpi::test::testNavigate();
 }
 
+BOOST_AUTO_TEST_CASE(NodalAnalysis)
+{
+    anpi::test::testNodal();
+}
+
+BOOST_AUTO_TEST_CASE(GrayscaleModel)
+{
+    anpi::test::testGrayscaleModel();
+}
+
+BOOST_AUTO_TEST_CASE(FactorOnce)
+{
+    anpi::test::testFactorOnce();
+}
+
+BOOST_AUTO_TEST_CASE(Cache)
+{
+    anpi::test::testCache();
+}
+
 BOOST_AUTO_TEST_CASE(Desplazamiento)
 {
     anpi::test::testDespla();
 }
+
+BOOST_AUTO_TEST_CASE(SmoothPath)
+{
+    anpi::test::testSmoothPath();
+}
+
+BOOST_AUTO_TEST_CASE(Batch)
+{
+    anpi::test::testBatch();
+}
+
+BOOST_AUTO_TEST_CASE(Concurrent)
+{
+    anpi::test::testConcurrent();
+}
+
+BOOST_AUTO_TEST_CASE(Arena)
+{
+    anpi::test::testArena();
+}
+
+BOOST_AUTO_TEST_CASE(StaleResults)
+{
+    anpi::test::testStaleResults();
+}
 BOOST_AUTO_TEST_CASE(MapLoading)
 {
     // anpi::test::testBuild();
@@ -0,0 +1,232 @@
+/**
+ * Copyright (C) 2018
+ * Área Académica de Ingeniería en Computadoras, TEC, Costa Rica
+ *
+ * This file is part of the CE3102 Numerical Analysis lecture at TEC
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "SparseMatrix.hpp"
+#include "SparseLU.hpp"
+#include "SparseCholesky.hpp"
+#include "Solver.hpp"
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+
+#include <cmath>
+
+namespace anpi
+{
+namespace test
+{
+
+/// Test the assembly and access of a CSR matrix
+template <typename T>
+void sparseAssemblyTest()
+{
+  //  | 4 0 1 |
+  //  | 0 0 0 |
+  //  | 2 3 0 |
+  SparseMatrix<T> A(3, 3);
+  A.insert(0, 2, T(1));
+  A.insert(0, 0, T(5));
+  A.insert(0, 0, T(4)); // replaces the previous value
+  A.insert(2, 1, T(3));
+  A.insert(2, 0, T(2));
+  A.finalize();
+
+  BOOST_CHECK(A.finalized());
+  BOOST_CHECK(A.nonZeros() == 4);
+
+  std::vector<size_t> rowPtr = {0, 2, 2, 4};
+  std::vector<size_t> colIdx = {0, 2, 0, 1};
+  BOOST_CHECK(A.rowPtr() == rowPtr);
+  BOOST_CHECK(A.colIdx() == colIdx);
+
+  BOOST_CHECK(A(0, 0) == T(4));
+  BOOST_CHECK(A(0, 1) == T(0));
+  BOOST_CHECK(A(1, 1) == T(0));
+  BOOST_CHECK(A(2, 1) == T(3));
+
+  Matrix<T> dense, ref = {{4, 0, 1}, {0, 0, 0}, {2, 3, 0}};
+  A.toDense(dense);
+  BOOST_CHECK(dense == ref);
+
+  std::vector<T> x = {1, 2, 3};
+  std::vector<T> y = A * x;
+  std::vector<T> ey = {7, 0, 8};
+  BOOST_CHECK(y == ey);
+
+  // the same matrix, with the rows filled in reverse order
+  SparseMatrix<T> B;
+  B.allocateRows(3, {2, 0, 2});
+  BOOST_CHECK(B.finalized());
+
+  const size_t c2[] = {0, 1}, c0[] = {0, 2};
+  const T v2[] = {2, 3}, v0[] = {4, 1};
+  B.setRow(2, c2, v2);
+  B.setRow(1, nullptr, nullptr);
+  B.setRow(0, c0, v0);
+
+  BOOST_CHECK(B.rowPtr() == rowPtr);
+  BOOST_CHECK(B.colIdx() == colIdx);
+  BOOST_CHECK(B * x == ey);
+}
+
+/// Compare the sparse solver against the expected solution
+template <typename T>
+void sparseSolverTest()
+{
+  // a matrix that requires pivoting: zero at the first diagonal element
+  anpi::Matrix<T> D = {{0, 2, 0, 1}, {2, 2, 3, 2}, {4, -3, 0, 1}, {6, 1, -6, -5}};
+  std::vector<T> b = {0, -2, -7, 6}, x;
+
+  SparseMatrix<T> A(D.rows(), D.cols());
+  for (size_t i = 0; i < D.rows(); ++i)
+  {
+    for (size_t j = 0; j < D.cols(); ++j)
+    {
+      if (D(i, j) != T(0))
+        A.insert(i, j, D(i, j));
+    }
+  }
+  A.finalize();
+
+  anpi::solveSparseLU(A, x, b);
+
+  const T eps = std::sqrt(std::numeric_limits<T>::epsilon());
+  std::vector<T> br = A * x;
+  for (size_t i = 0; i < b.size(); ++i)
+  {
+    BOOST_CHECK(std::abs(br[i] - b[i]) < eps);
+  }
+
+  // singular matrices must be detected
+  SparseMatrix<T> S(2, 2);
+  S.insert(0, 0, T(1));
+  S.insert(1, 0, T(2));
+  S.finalize();
+  std::vector<T> bs = {1, 1};
+  BOOST_CHECK_THROW(anpi::solveSparseLU(S, x, bs), anpi::Exception);
+}
+
+/// Factorize a symmetric positive definite matrix once, solve many times
+template <typename T>
+void sparseCholeskyTest()
+{
+  // Laplacian of a 3x3 grid with a grounded corner
+  const size_t n = 3, nodes = n * n;
+  SparseMatrix<T> A(nodes, nodes);
+  for (size_t k = 0; k < nodes; ++k)
+  {
+    const size_t i = k / n, j = k % n;
+    if (k == 0)
+    {
+      A.insert(k, k, T(1));
+      continue;
+    }
+    T diag = T(0);
+    const long nb[4][2] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}};
+    for (const auto &d : nb)
+    {
+      const long ni = long(i) + d[0], nj = long(j) + d[1];
+      if ((ni < 0) || (nj < 0) || (ni >= long(n)) || (nj >= long(n)))
+        continue;
+      diag += T(1);
+      const size_t q = size_t(ni) * n + size_t(nj);
+      if (q != 0)
+        A.insert(k, q, T(-1));
+    }
+    A.insert(k, k, diag);
+  }
+  A.finalize();
+
+  SparseCholesky<T> chol;
+  BOOST_CHECK(!chol.factored());
+  chol.factor(A);
+  BOOST_CHECK(chol.factored());
+
+  const T eps = std::sqrt(std::numeric_limits<T>::epsilon());
+  for (size_t s = 1; s < nodes; ++s)
+  {
+    std::vector<T> b(nodes, T(0)), x;
+    b[s] = T(1);
+    b[(s * 5) % nodes] -= T(1);
+    chol.solve(b, x);
+    const std::vector<T> br = A * x;
+    for (size_t i = 0; i < nodes; ++i)
+    {
+      BOOST_CHECK(std::abs(br[i] - b[i]) < eps);
+    }
+  }
+
+  // all right hand sides at once
+  Matrix<T> B(nodes, 3, T(0)), X;
+  for (size_t k = 0; k < 3; ++k)
+  {
+    B(k + 2, k) = T(1);
+    B(nodes - 1 - k, k) = T(-1);
+  }
+  chol.solve(B, X);
+  BOOST_CHECK(X.rows() == nodes && X.cols() == 3);
+  for (size_t k = 0; k < 3; ++k)
+  {
+    std::vector<T> b(nodes), x;
+    for (size_t i = 0; i < nodes; ++i)
+      b[i] = B(i, k);
+    chol.solve(b, x);
+    for (size_t i = 0; i < nodes; ++i)
+    {
+      BOOST_CHECK(std::abs(X(i, k) - x[i]) < eps);
+    }
+  }
+
+  // indefinite matrices must be detected
+  SparseMatrix<T> S(2, 2);
+  S.insert(0, 0, T(1));
+  S.insert(0, 1, T(2));
+  S.insert(1, 0, T(2));
+  S.insert(1, 1, T(1));
+  S.finalize();
+
+  // only matrices with the profile of the factored one fit the factor
+  SparseMatrix<T> D(nodes, nodes);
+  for (size_t k = 0; k < nodes; ++k)
+  {
+    D.insert(k, k, T(2));
+  }
+  D.finalize();
+  BOOST_CHECK(chol.hasProfileOf(A));
+  BOOST_CHECK(!chol.hasProfileOf(D));
+  BOOST_CHECK(!chol.hasProfileOf(S));
+
+  BOOST_CHECK_THROW(chol.factor(S), anpi::Exception);
+}
+
+} // namespace test
+} // namespace anpi
+
+BOOST_AUTO_TEST_SUITE(SparseMatrix)
+
+BOOST_AUTO_TEST_CASE(Assembly)
+{
+  anpi::test::sparseAssemblyTest<float>();
+  anpi::test::sparseAssemblyTest<double>();
+}
+
+BOOST_AUTO_TEST_CASE(SparseLU)
+{
+  anpi::test::sparseSolverTest<float>();
+  anpi::test::sparseSolverTest<double>();
+}
+
+BOOST_AUTO_TEST_CASE(SparseCholesky)
+{
+  anpi::test::sparseCholeskyTest<float>();
+  anpi::test::sparseCholeskyTest<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()